@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "alias_planner.hh"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+bool lifetimes_overlap(const AliasRequest &a, const AliasRequest &b) {
+  return a.first_step <= b.last_step && b.first_step <= a.last_step;
+}
+
+VkDeviceSize align_up(VkDeviceSize offset, VkDeviceSize alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+AliasPlan plan_aliases(std::span<const AliasRequest> requests) {
+  AliasPlan plan;
+  plan.pool_indices.resize(requests.size());
+  plan.offsets.resize(requests.size());
+  plan.reuses_memory.resize(requests.size());
+
+  for (std::size_t i = 0; i < requests.size(); i++) {
+    auto pool = std::find_if(plan.pools.begin(), plan.pools.end(),
+                             [&](const AliasPool &pool) { return pool.flags == requests[i].flags; });
+    if (pool == plan.pools.end()) {
+      plan.pools.push_back({requests[i].flags, requests[i].type_mask, 0});
+      pool = plan.pools.end() - 1;
+    }
+    pool->type_mask &= requests[i].type_mask;
+    if (pool->type_mask == 0) {
+      throw std::runtime_error("aliased buffers have no memory type in common");
+    }
+    plan.pool_indices[i] = pool - plan.pools.begin();
+  }
+
+  std::vector<std::size_t> order(requests.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](std::size_t a, std::size_t b) { return requests[a].size > requests[b].size; });
+
+  std::vector<std::size_t> placed;
+  for (std::size_t i : order) {
+    const AliasRequest &request = requests[i];
+    // Ranges that are taken while this request is live
+    std::vector<std::pair<VkDeviceSize, VkDeviceSize>> taken;
+    for (std::size_t j : placed) {
+      if (plan.pool_indices[j] == plan.pool_indices[i] && lifetimes_overlap(request, requests[j])) {
+        taken.emplace_back(plan.offsets[j], plan.offsets[j] + requests[j].size);
+      }
+    }
+    std::sort(taken.begin(), taken.end());
+
+    // Lowest gap that fits
+    VkDeviceSize offset = 0;
+    for (const auto &[start, end] : taken) {
+      if (offset + request.size <= start) {
+        break;
+      }
+      offset = std::max(offset, align_up(end, request.alignment));
+    }
+    plan.offsets[i] = offset;
+    AliasPool &pool = plan.pools[plan.pool_indices[i]];
+    pool.size = std::max(pool.size, offset + request.size);
+    placed.push_back(i);
+  }
+
+  for (std::size_t i = 0; i < requests.size(); i++) {
+    for (std::size_t j = 0; j < requests.size(); j++) {
+      if (plan.pool_indices[j] == plan.pool_indices[i] && requests[j].last_step < requests[i].first_step &&
+          plan.offsets[j] < plan.offsets[i] + requests[i].size &&
+          plan.offsets[i] < plan.offsets[j] + requests[j].size) {
+        plan.reuses_memory[i] = true;
+      }
+    }
+  }
+  return plan;
+}
+
+VkDeviceSize unaliased_size(std::span<const AliasRequest> requests) {
+  VkDeviceSize size = 0;
+  for (const AliasRequest &request : requests) {
+    size += request.size;
+  }
+  return size;
+}
+
+AliasedMemory::AliasedMemory(const Context &context, const AliasPlan &plan, VkMemoryAllocateFlags allocate_flags) {
+  for (const AliasPool &pool : plan.pools) {
+    m_pools.emplace_back(new Memory(context.allocate_memory(pool.size, pool.flags, pool.type_mask, allocate_flags)));
+  }
+}
+
+void record_alias_barrier(const CommandBuffer &command_buffer) {
+  VkMemoryBarrier2 barrier{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+      .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+      .srcAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+      .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+      .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+  };
+  VkDependencyInfo dependency_info{
+      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .memoryBarrierCount = 1,
+      .pMemoryBarriers = &barrier,
+  };
+  vkCmdPipelineBarrier2(command_buffer.handle(), &dependency_info);
+}
@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#pragma once
+
+#include "vkcontext.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+// A buffer that only needs its memory from first_step to last_step of a
+// sequence of steps, inclusive
+struct AliasRequest {
+  VkDeviceSize size;
+  VkDeviceSize alignment;
+  // Exact memory property flags, as for Buffer::allocate
+  std::uint32_t flags;
+  // memoryTypeBits of the buffer's memory requirements
+  std::uint32_t type_mask;
+  int first_step;
+  int last_step;
+};
+
+// One allocation shared by all requests with the same flags
+struct AliasPool {
+  std::uint32_t flags;
+  std::uint32_t type_mask;
+  VkDeviceSize size;
+};
+
+struct AliasPlan {
+  std::vector<AliasPool> pools;
+  // Pool and offset of each request
+  std::vector<std::size_t> pool_indices;
+  std::vector<VkDeviceSize> offsets;
+  // Whether a request's memory was used by a request that ended before it
+  // started. Its first use needs record_alias_barrier.
+  std::vector<bool> reuses_memory;
+};
+
+// Requests whose lifetimes overlap get disjoint ranges, the others may share
+// memory. Requests are placed largest first at the lowest aligned offset that
+// does not collide with a placed request that is live at the same time, so
+// each pool ends up close to the peak of the bytes live in any one step.
+// Throws if requests with the same flags have no memory type in common.
+AliasPlan plan_aliases(std::span<const AliasRequest> requests);
+
+// Total size of the requests, which is what allocating each one on its own
+// would hold if they were all live
+VkDeviceSize unaliased_size(std::span<const AliasRequest> requests);
+
+// The pools of a plan, allocated for buffers to bind to
+class AliasedMemory {
+  std::vector<std::unique_ptr<Memory>> m_pools;
+
+public:
+  AliasedMemory(const Context &context, const AliasPlan &plan, VkMemoryAllocateFlags allocate_flags = 0);
+  AliasedMemory(const AliasedMemory &) = delete;
+  AliasedMemory(AliasedMemory &&) = delete;
+
+  const Memory &pool(std::size_t index) const { return *m_pools[index]; }
+};
+
+// Orders every earlier access to memory before every later one, including
+// those in later submissions. Recorded before the first use of a buffer whose
+// memory was used by another buffer, whose contents are then undefined.
+void record_alias_barrier(const CommandBuffer &command_buffer);
@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "benchmark.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+double elapsed_seconds(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+double timed_submit(const Context &context, const CommandBuffer &command_buffer, const Fence &fence,
+                    const QueryPool &query_pool) {
+  command_buffer.submit(fence);
+  fence.wait();
+  fence.reset();
+
+  std::vector<std::uint64_t> timestamps = query_pool.results();
+  return static_cast<double>(timestamps[1] - timestamps[0]) * context.timestamp_period() / 1e9;
+}
+
+void record_kernel_copy(const CommandBuffer &command_buffer, const ComputePipeline &pipeline, const Buffer &src,
+                        const Buffer &dst, std::uint64_t size) {
+  CopyPushConstants push_constants{
+      .src = src.device_address(),
+      .dst = dst.device_address(),
+      .count = static_cast<std::uint32_t>(size / 16),
+  };
+
+  // The kernel loops over the buffer, so the grid only needs to be big
+  // enough to fill the device.
+  std::uint32_t group_count = std::clamp<std::uint32_t>((push_constants.count + 255) / 256, 1, 65535);
+
+  vkCmdBindPipeline(command_buffer.handle(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.handle());
+  vkCmdPushConstants(command_buffer.handle(), pipeline.layout(), VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                     sizeof(push_constants), &push_constants);
+  vkCmdDispatch(command_buffer.handle(), group_count, 1, 1);
+}
+
+void print_pipeline_statistics(const char *label, std::span<const PipelineExecutable> executables) {
+  for (const PipelineExecutable &executable : executables) {
+    std::cout << "  " << label << " " << executable.name << " (subgroup " << executable.subgroup_size << "):";
+    for (const PipelineStatistic &statistic : executable.statistics) {
+      std::cout << ' ' << statistic.name << '=' << statistic.value << ';';
+    }
+    std::cout << '\n';
+  }
+}
+
+std::uint64_t peak_rss_bytes() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    // VmHWM:     1234 kB
+    if (line.starts_with("VmHWM:")) {
+      return std::stoull(line.substr(6)) * 1024;
+    }
+  }
+  return 0;
+}
+
+void reset_peak_rss() {
+  // Writing 5 resets VmHWM to the current RSS (Linux 4.0 and later)
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5";
+}
+
+double mib_per_second(std::uint64_t bytes, double seconds) { return bytes / seconds / 1024 / 1024; }
+
+double percentile(std::span<const double> samples, double p) {
+  std::vector<double> sorted(samples.begin(), samples.end());
+  std::size_t rank = std::min(static_cast<std::size_t>(p * sorted.size()), sorted.size() - 1);
+  std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+  return sorted[rank];
+}
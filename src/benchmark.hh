@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#pragma once
+
+#include "suite.hh"
+#include "vkcontext.hh"
+
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+using Clock = std::chrono::steady_clock;
+
+// Host time elapsed since start, in seconds
+double elapsed_seconds(Clock::time_point start);
+
+// Submits a command buffer that writes timestamps 0 and 1 into query_pool,
+// waits for it to complete and returns the elapsed GPU time in seconds.
+double timed_submit(const Context &context, const CommandBuffer &command_buffer, const Fence &fence,
+                    const QueryPool &query_pool);
+
+// Push constants of the copy kernel (src/shaders/copy.comp)
+struct CopyPushConstants {
+  VkDeviceAddress src;
+  VkDeviceAddress dst;
+  // Number of 16 byte elements
+  std::uint32_t count;
+};
+
+// Push constants of the strided read kernel (src/shaders/partition_stride.comp)
+struct PartitionStridePushConstants {
+  VkDeviceAddress src;
+  VkDeviceAddress dst;
+  std::uint32_t size_mask;
+  std::uint32_t lap_chunk_count;
+  std::uint32_t stride;
+  std::uint32_t offset;
+  std::uint32_t pass_count;
+};
+
+// Matches CHUNK_SIZE in src/shaders/partition_stride.comp
+constexpr std::uint32_t partition_stride_chunk_size = 256;
+
+// Records a dispatch of the copy kernel. Both buffers must have been created
+// with device address usage, and size must be a multiple of 16.
+void record_kernel_copy(const CommandBuffer &command_buffer, const ComputePipeline &pipeline, const Buffer &src,
+                        const Buffer &dst, std::uint64_t size);
+
+// Prints the compiler statistics of each pipeline executable under a results
+// line. Prints nothing when the device does not report them.
+void print_pipeline_statistics(const char *label, std::span<const PipelineExecutable> executables);
+
+// Peak resident set size of the process in bytes, since the last
+// reset_peak_rss if the kernel supports resetting it
+std::uint64_t peak_rss_bytes();
+void reset_peak_rss();
+
+double mib_per_second(std::uint64_t bytes, double seconds);
+
+// p in [0, 1], nearest rank. samples must not be empty.
+double percentile(std::span<const double> samples, double p);
+
+void usage_benchmark(Context &context);
+void object_count_benchmark(Context &context);
+void live_allocation_benchmark(Context &context);
+void binding_benchmark(Context &context);
+void copy_list_benchmark(Context &context);
+void robustness_benchmark(Context &context);
+void pipeline_statistics_benchmark(Context &context);
+void first_use_benchmark(Context &context);
+void page_stride_benchmark(Context &context);
+void partition_stride_benchmark(Context &context);
+void roofline_benchmark(Context &context);
+void query_retrieval_benchmark(Context &context);
+void placed_map_benchmark(Context &context);
+void host_allocator_benchmark(Context &context);
+void write_combining_benchmark(Context &context);
+
+// Suite points of the benchmarks above that can run under --budget and
+// --rounds
+std::vector<SuitePoint> usage_points(Context &context);
+std::vector<SuitePoint> page_stride_points(Context &context);
+std::vector<SuitePoint> partition_stride_points(Context &context);
@@ -0,0 +1,492 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "benchmark.hh"
+#include "hostcopy.hh"
+#include "shaders.hh"
+#include "vkcontext.hh"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+namespace {
+
+constexpr std::array buffer_counts{1u, 2u, 4u, 8u, 16u, 32u, 64u};
+constexpr std::uint32_t max_buffer_count = 64;
+
+constexpr std::uint32_t dispatch_count = 1024;
+constexpr int iteration_count = 4;
+
+// Each input holds one value per invocation of the 64 wide workgroup, and
+// each dispatch writes its sums to its own slice of the output buffer.
+constexpr std::uint32_t input_size = 64 * sizeof(std::uint32_t);
+constexpr VkDeviceSize output_stride = 256;
+
+struct DispatchCost {
+  double cpu_seconds;
+  double gpu_seconds;
+  std::vector<PipelineExecutable> executables;
+};
+
+struct BindingResources {
+  std::vector<std::unique_ptr<Buffer>> inputs;
+  std::unique_ptr<Buffer> output;
+};
+
+struct AddressPushConstants {
+  VkDeviceAddress table;
+  VkDeviceAddress result;
+  std::uint32_t count;
+};
+
+// Matches the push constants of src/shaders/bind_push_address.comp, which
+// fill the 128 bytes that every device supports
+constexpr std::uint32_t max_pushed_address_count = 14;
+
+struct PushedAddressPushConstants {
+  VkDeviceAddress result;
+  std::uint32_t count;
+  std::array<VkDeviceAddress, max_pushed_address_count> inputs;
+};
+static_assert(sizeof(PushedAddressPushConstants) == 128);
+
+// Dispatch d binds inputs (d + i) % max_buffer_count for i < buffer count,
+// so consecutive dispatches never see the same bindings.
+const Buffer &input_for(const BindingResources &resources, std::uint32_t dispatch, std::uint32_t index) {
+  return *resources.inputs[(dispatch + index) % max_buffer_count];
+}
+
+// Records and submits dispatch_count dispatches through record, returning
+// the host recording time (including any descriptor updates) and GPU time
+// per dispatch.
+template <typename Record>
+DispatchCost measure_dispatches(const Context &context, Record record) {
+  QueryPool query_pool = context.create_timestamp_query_pool(2);
+  Fence fence = context.create_fence();
+
+  double cpu_seconds = 0;
+  double gpu_seconds = 0;
+  for (int count = 0; count < iteration_count; count++) {
+    CommandBuffer command_buffer = context.create_command_buffer();
+
+    Clock::time_point start = Clock::now();
+    command_buffer.begin();
+    vkCmdResetQueryPool(command_buffer.handle(), query_pool.handle(), 0, 2);
+    vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_NONE, query_pool.handle(), 0);
+    record(command_buffer);
+    vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, query_pool.handle(), 1);
+    command_buffer.end();
+    cpu_seconds += elapsed_seconds(start);
+
+    gpu_seconds += timed_submit(context, command_buffer, fence, query_pool);
+  }
+  return {cpu_seconds / (iteration_count * dispatch_count), gpu_seconds / (iteration_count * dispatch_count)};
+}
+
+VkDescriptorSetLayout create_set_layout(const Context &context, std::uint32_t buffer_count,
+                                        VkDescriptorSetLayoutCreateFlags flags) {
+  std::array<VkDescriptorSetLayoutBinding, 2> bindings{
+      VkDescriptorSetLayoutBinding{
+          .binding = 0,
+          .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .descriptorCount = buffer_count,
+          .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+      },
+      VkDescriptorSetLayoutBinding{
+          .binding = 1,
+          .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .descriptorCount = 1,
+          .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+      },
+  };
+  VkDescriptorSetLayoutCreateInfo set_layout_ci{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .flags = flags,
+      .bindingCount = bindings.size(),
+      .pBindings = bindings.data(),
+  };
+  VkDescriptorSetLayout set_layout;
+  if (vkCreateDescriptorSetLayout(context.device(), &set_layout_ci, context.allocation_callbacks(), &set_layout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("unable to create descriptor set layout");
+  }
+  return set_layout;
+}
+
+// The input array of the kernel is sized by a specialization constant
+ComputePipeline create_descriptor_pipeline(const Context &context, VkDescriptorSetLayout set_layout,
+                                           std::uint32_t buffer_count, VkPipelineCreateFlags flags) {
+  VkSpecializationMapEntry specialization_entry{
+      .constantID = 0,
+      .offset = 0,
+      .size = sizeof(buffer_count),
+  };
+  VkSpecializationInfo specialization{
+      .mapEntryCount = 1,
+      .pMapEntries = &specialization_entry,
+      .dataSize = sizeof(buffer_count),
+      .pData = &buffer_count,
+  };
+  return context.create_compute_pipeline(shaders::bind_descriptor, 0, {&set_layout, 1}, &specialization, flags);
+}
+
+// Fills buffer_infos with the inputs for a dispatch followed by its output
+// slice, and returns writes for both bindings that point into it.
+std::array<VkWriteDescriptorSet, 2> descriptor_writes(const BindingResources &resources, std::uint32_t buffer_count,
+                                                      std::uint32_t dispatch, VkDescriptorSet set,
+                                                      std::span<VkDescriptorBufferInfo> buffer_infos) {
+  for (std::uint32_t i = 0; i < buffer_count; i++) {
+    buffer_infos[i] = {
+        .buffer = input_for(resources, dispatch, i).handle(),
+        .offset = 0,
+        .range = VK_WHOLE_SIZE,
+    };
+  }
+  buffer_infos[buffer_count] = {
+      .buffer = resources.output->handle(),
+      .offset = output_stride * dispatch,
+      .range = output_stride,
+  };
+  return {
+      VkWriteDescriptorSet{
+          .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+          .dstSet = set,
+          .dstBinding = 0,
+          .descriptorCount = buffer_count,
+          .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .pBufferInfo = buffer_infos.data(),
+      },
+      VkWriteDescriptorSet{
+          .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+          .dstSet = set,
+          .dstBinding = 1,
+          .descriptorCount = 1,
+          .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .pBufferInfo = &buffer_infos[buffer_count],
+      },
+  };
+}
+
+// vkUpdateDescriptorSets into a fresh set per dispatch, then bind it
+DispatchCost descriptor_set_benchmark(const Context &context, const BindingResources &resources,
+                                      std::uint32_t buffer_count) {
+  VkDescriptorSetLayout set_layout = create_set_layout(context, buffer_count, 0);
+
+  ComputePipeline pipeline = create_descriptor_pipeline(context, set_layout, buffer_count, 0);
+
+  VkDescriptorPoolSize pool_size{
+      .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .descriptorCount = dispatch_count * (buffer_count + 1),
+  };
+  VkDescriptorPoolCreateInfo pool_ci{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .maxSets = dispatch_count,
+      .poolSizeCount = 1,
+      .pPoolSizes = &pool_size,
+  };
+  VkDescriptorPool pool;
+  if (vkCreateDescriptorPool(context.device(), &pool_ci, context.allocation_callbacks(), &pool) != VK_SUCCESS) {
+    throw std::runtime_error("unable to create descriptor pool");
+  }
+
+  std::vector<VkDescriptorSetLayout> set_layouts(dispatch_count, set_layout);
+  std::vector<VkDescriptorSet> sets(dispatch_count);
+  VkDescriptorSetAllocateInfo set_ai{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .descriptorPool = pool,
+      .descriptorSetCount = dispatch_count,
+      .pSetLayouts = set_layouts.data(),
+  };
+  if (vkAllocateDescriptorSets(context.device(), &set_ai, sets.data()) != VK_SUCCESS) {
+    throw std::runtime_error("unable to allocate descriptor sets");
+  }
+
+  std::vector<VkDescriptorBufferInfo> buffer_infos(buffer_count + 1);
+  DispatchCost cost = measure_dispatches(context, [&](const CommandBuffer &command_buffer) {
+    vkCmdBindPipeline(command_buffer.handle(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.handle());
+    for (std::uint32_t dispatch = 0; dispatch < dispatch_count; dispatch++) {
+      std::array<VkWriteDescriptorSet, 2> writes =
+          descriptor_writes(resources, buffer_count, dispatch, sets[dispatch], buffer_infos);
+      vkUpdateDescriptorSets(context.device(), writes.size(), writes.data(), 0, nullptr);
+      vkCmdBindDescriptorSets(command_buffer.handle(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.layout(), 0, 1,
+                              &sets[dispatch], 0, nullptr);
+      vkCmdDispatch(command_buffer.handle(), 1, 1, 1);
+    }
+  });
+  cost.executables = pipeline.executables();
+
+  vkDestroyDescriptorPool(context.device(), pool, context.allocation_callbacks());
+  vkDestroyDescriptorSetLayout(context.device(), set_layout, context.allocation_callbacks());
+  return cost;
+}
+
+// VK_KHR_push_descriptor
+DispatchCost push_descriptor_benchmark(const Context &context, const BindingResources &resources,
+                                       std::uint32_t buffer_count) {
+  auto cmd_push_descriptor_set = context.device_function<PFN_vkCmdPushDescriptorSetKHR>("vkCmdPushDescriptorSetKHR");
+
+  VkDescriptorSetLayout set_layout =
+      create_set_layout(context, buffer_count, VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR);
+
+  ComputePipeline pipeline = create_descriptor_pipeline(context, set_layout, buffer_count, 0);
+
+  std::vector<VkDescriptorBufferInfo> buffer_infos(buffer_count + 1);
+  DispatchCost cost = measure_dispatches(context, [&](const CommandBuffer &command_buffer) {
+    vkCmdBindPipeline(command_buffer.handle(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.handle());
+    for (std::uint32_t dispatch = 0; dispatch < dispatch_count; dispatch++) {
+      std::array<VkWriteDescriptorSet, 2> writes =
+          descriptor_writes(resources, buffer_count, dispatch, VK_NULL_HANDLE, buffer_infos);
+      cmd_push_descriptor_set(command_buffer.handle(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.layout(), 0,
+                              writes.size(), writes.data());
+      vkCmdDispatch(command_buffer.handle(), 1, 1, 1);
+    }
+  });
+  cost.executables = pipeline.executables();
+
+  vkDestroyDescriptorSetLayout(context.device(), set_layout, context.allocation_callbacks());
+  return cost;
+}
+
+// VK_EXT_descriptor_buffer, with descriptors for each dispatch written
+// into their own slice of one host-visible descriptor buffer
+DispatchCost descriptor_buffer_benchmark(const Context &context, const BindingResources &resources,
+                                         std::uint32_t buffer_count) {
+  auto get_descriptor_set_layout_size =
+      context.device_function<PFN_vkGetDescriptorSetLayoutSizeEXT>("vkGetDescriptorSetLayoutSizeEXT");
+  auto get_descriptor_set_layout_binding_offset =
+      context.device_function<PFN_vkGetDescriptorSetLayoutBindingOffsetEXT>(
+          "vkGetDescriptorSetLayoutBindingOffsetEXT");
+  auto get_descriptor = context.device_function<PFN_vkGetDescriptorEXT>("vkGetDescriptorEXT");
+  auto cmd_bind_descriptor_buffers =
+      context.device_function<PFN_vkCmdBindDescriptorBuffersEXT>("vkCmdBindDescriptorBuffersEXT");
+  auto cmd_set_descriptor_buffer_offsets =
+      context.device_function<PFN_vkCmdSetDescriptorBufferOffsetsEXT>("vkCmdSetDescriptorBufferOffsetsEXT");
+
+  VkPhysicalDeviceDescriptorBufferPropertiesEXT descriptor_buffer_properties{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT,
+  };
+  VkPhysicalDeviceProperties2 properties{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+      .pNext = &descriptor_buffer_properties,
+  };
+  vkGetPhysicalDeviceProperties2(context.physical_device(), &properties);
+  const std::size_t descriptor_size = descriptor_buffer_properties.storageBufferDescriptorSize;
+
+  VkDescriptorSetLayout set_layout =
+      create_set_layout(context, buffer_count, VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT);
+  VkDeviceSize set_size;
+  get_descriptor_set_layout_size(context.device(), set_layout, &set_size);
+  std::array<VkDeviceSize, 2> binding_offsets;
+  get_descriptor_set_layout_binding_offset(context.device(), set_layout, 0, &binding_offsets[0]);
+  get_descriptor_set_layout_binding_offset(context.device(), set_layout, 1, &binding_offsets[1]);
+
+  const VkDeviceSize alignment = descriptor_buffer_properties.descriptorBufferOffsetAlignment;
+  const VkDeviceSize set_stride = (set_size + alignment - 1) / alignment * alignment;
+
+  Buffer descriptor_buffer = context.create_buffer(set_stride * dispatch_count,
+                                                   VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT |
+                                                       VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+  descriptor_buffer.allocate(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  std::span<std::uint8_t> descriptors = descriptor_buffer.mmap();
+
+  ComputePipeline pipeline =
+      create_descriptor_pipeline(context, set_layout, buffer_count, VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT);
+
+  std::vector<VkDeviceAddress> input_addresses;
+  for (const std::unique_ptr<Buffer> &input : resources.inputs) {
+    input_addresses.push_back(input->device_address());
+  }
+  const VkDeviceAddress output_address = resources.output->device_address();
+
+  auto write_descriptor = [&](VkDeviceAddress address, VkDeviceSize range, std::uint8_t *destination) {
+    VkDescriptorAddressInfoEXT address_info{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT,
+        .address = address,
+        .range = range,
+    };
+    VkDescriptorGetInfoEXT get_info{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT,
+        .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .data = {.pStorageBuffer = &address_info},
+    };
+    get_descriptor(context.device(), &get_info, descriptor_size, destination);
+  };
+
+  DispatchCost cost = measure_dispatches(context, [&](const CommandBuffer &command_buffer) {
+    VkDescriptorBufferBindingInfoEXT binding_info{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT,
+        .address = descriptor_buffer.device_address(),
+        .usage = VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT,
+    };
+    vkCmdBindPipeline(command_buffer.handle(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.handle());
+    cmd_bind_descriptor_buffers(command_buffer.handle(), 1, &binding_info);
+    for (std::uint32_t dispatch = 0; dispatch < dispatch_count; dispatch++) {
+      VkDeviceSize set_offset = set_stride * dispatch;
+      std::uint8_t *set = descriptors.data() + set_offset;
+      for (std::uint32_t i = 0; i < buffer_count; i++) {
+        write_descriptor(input_addresses[(dispatch + i) % max_buffer_count], input_size,
+                         set + binding_offsets[0] + i * descriptor_size);
+      }
+      write_descriptor(output_address + output_stride * dispatch, output_stride, set + binding_offsets[1]);
+
+      std::uint32_t buffer_index = 0;
+      cmd_set_descriptor_buffer_offsets(command_buffer.handle(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.layout(), 0,
+                                        1, &buffer_index, &set_offset);
+      vkCmdDispatch(command_buffer.handle(), 1, 1, 1);
+    }
+  });
+  cost.executables = pipeline.executables();
+
+  vkDestroyDescriptorSetLayout(context.device(), set_layout, context.allocation_callbacks());
+  return cost;
+}
+
+// Raw device addresses pushed along with the output address, for buffer
+// counts up to max_pushed_address_count. Only the addresses in use are pushed.
+DispatchCost pushed_address_benchmark(const Context &context, const BindingResources &resources,
+                                      std::uint32_t buffer_count) {
+  ComputePipeline pipeline =
+      context.create_compute_pipeline(shaders::bind_push_address, sizeof(PushedAddressPushConstants));
+
+  std::vector<VkDeviceAddress> input_addresses;
+  for (const std::unique_ptr<Buffer> &input : resources.inputs) {
+    input_addresses.push_back(input->device_address());
+  }
+  const VkDeviceAddress output_address = resources.output->device_address();
+  const std::uint32_t push_size = offsetof(PushedAddressPushConstants, inputs) + buffer_count * sizeof(VkDeviceAddress);
+
+  DispatchCost cost = measure_dispatches(context, [&](const CommandBuffer &command_buffer) {
+    vkCmdBindPipeline(command_buffer.handle(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.handle());
+    for (std::uint32_t dispatch = 0; dispatch < dispatch_count; dispatch++) {
+      PushedAddressPushConstants push_constants{
+          .result = output_address + output_stride * dispatch,
+          .count = buffer_count,
+      };
+      for (std::uint32_t i = 0; i < buffer_count; i++) {
+        push_constants.inputs[i] = input_addresses[(dispatch + i) % max_buffer_count];
+      }
+      vkCmdPushConstants(command_buffer.handle(), pipeline.layout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, push_size,
+                         &push_constants);
+      vkCmdDispatch(command_buffer.handle(), 1, 1, 1);
+    }
+  });
+  cost.executables = pipeline.executables();
+  return cost;
+}
+
+// Fallback for more addresses than fit in push constants: the addresses for
+// each dispatch are written into its own slice of a host-visible table whose
+// address is pushed along with the output address.
+DispatchCost device_address_table_benchmark(const Context &context, const BindingResources &resources,
+                                            std::uint32_t buffer_count) {
+  ComputePipeline pipeline = context.create_compute_pipeline(shaders::bind_address, sizeof(AddressPushConstants));
+
+  constexpr VkDeviceSize table_stride = max_buffer_count * sizeof(VkDeviceAddress);
+  Buffer table = context.create_buffer(table_stride * dispatch_count,
+                                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+  table.allocate(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  std::span<std::uint8_t> table_data = table.mmap();
+  const VkDeviceAddress table_address = table.device_address();
+
+  std::vector<VkDeviceAddress> input_addresses;
+  for (const std::unique_ptr<Buffer> &input : resources.inputs) {
+    input_addresses.push_back(input->device_address());
+  }
+  const VkDeviceAddress output_address = resources.output->device_address();
+
+  DispatchCost cost = measure_dispatches(context, [&](const CommandBuffer &command_buffer) {
+    vkCmdBindPipeline(command_buffer.handle(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.handle());
+    for (std::uint32_t dispatch = 0; dispatch < dispatch_count; dispatch++) {
+      std::array<VkDeviceAddress, max_buffer_count> addresses;
+      for (std::uint32_t i = 0; i < buffer_count; i++) {
+        addresses[i] = input_addresses[(dispatch + i) % max_buffer_count];
+      }
+      host_copy(table, table_data.subspan(table_stride * dispatch, table_stride),
+                {reinterpret_cast<const std::uint8_t *>(addresses.data()), buffer_count * sizeof(VkDeviceAddress)});
+
+      AddressPushConstants push_constants{
+          .table = table_address + table_stride * dispatch,
+          .result = output_address + output_stride * dispatch,
+          .count = buffer_count,
+      };
+      vkCmdPushConstants(command_buffer.handle(), pipeline.layout(), VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                         sizeof(push_constants), &push_constants);
+      vkCmdDispatch(command_buffer.handle(), 1, 1, 1);
+    }
+  });
+  cost.executables = pipeline.executables();
+  return cost;
+}
+
+bool descriptor_buffer_supported(const Context &context) {
+  if (!context.has_extension(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME)) {
+    return false;
+  }
+  VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptor_buffer_features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT,
+  };
+  VkPhysicalDeviceFeatures2 features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+      .pNext = &descriptor_buffer_features,
+  };
+  vkGetPhysicalDeviceFeatures2(context.physical_device(), &features);
+  return descriptor_buffer_features.descriptorBuffer;
+}
+
+void print_cost(const char *model, std::uint32_t buffer_count, const DispatchCost &cost) {
+  std::cout << model << ", " << buffer_count << " buffers: cpu " << cost.cpu_seconds * 1e9 << " ns, gpu "
+            << cost.gpu_seconds * 1e9 << " ns per dispatch\n";
+  print_pipeline_statistics("kernel", cost.executables);
+}
+
+} // namespace
+
+void binding_benchmark(Context &context) {
+  VkPhysicalDevicePushDescriptorPropertiesKHR push_descriptor_properties{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PUSH_DESCRIPTOR_PROPERTIES_KHR,
+  };
+  VkPhysicalDeviceProperties2 properties{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+      .pNext = context.has_extension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME) ? &push_descriptor_properties : nullptr,
+  };
+  vkGetPhysicalDeviceProperties2(context.physical_device(), &properties);
+  const std::uint32_t max_storage_buffers = properties.properties.limits.maxPerStageDescriptorStorageBuffers;
+  const bool has_descriptor_buffer = descriptor_buffer_supported(context);
+
+  const VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+                                   VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  BindingResources resources;
+  for (std::uint32_t i = 0; i < max_buffer_count; i++) {
+    resources.inputs.emplace_back(new Buffer(context.create_buffer(input_size, usage)));
+    resources.inputs.back()->allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  }
+  resources.output.reset(new Buffer(context.create_buffer(output_stride * dispatch_count, usage)));
+  resources.output->allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  std::cout << "descriptor binding models (" << dispatch_count << " dispatches)\n--------------------\n";
+  for (std::uint32_t buffer_count : buffer_counts) {
+    // One more descriptor is needed for the output
+    if (buffer_count + 1 <= max_storage_buffers) {
+      print_cost("descriptor-set", buffer_count, descriptor_set_benchmark(context, resources, buffer_count));
+    }
+    if (context.has_extension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME) && buffer_count + 1 <= max_storage_buffers &&
+        buffer_count + 1 <= push_descriptor_properties.maxPushDescriptors) {
+      print_cost("push-descriptor", buffer_count, push_descriptor_benchmark(context, resources, buffer_count));
+    }
+    if (has_descriptor_buffer && buffer_count + 1 <= max_storage_buffers) {
+      print_cost("descriptor-buffer", buffer_count, descriptor_buffer_benchmark(context, resources, buffer_count));
+    }
+    if (buffer_count <= max_pushed_address_count) {
+      print_cost("device-address push", buffer_count, pushed_address_benchmark(context, resources, buffer_count));
+    } else {
+      print_cost("device-address table", buffer_count,
+                 device_address_table_benchmark(context, resources, buffer_count));
+    }
+  }
+}
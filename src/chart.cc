@@ -0,0 +1,208 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "chart.hh"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+namespace {
+
+std::filesystem::path output_directory;
+
+constexpr double width = 800;
+constexpr double height = 500;
+constexpr double margin_left = 80;
+constexpr double margin_right = 200;
+constexpr double margin_top = 40;
+constexpr double margin_bottom = 60;
+
+constexpr std::array colors{"#1f77b4", "#ff7f0e", "#2ca02c", "#d62728", "#9467bd",
+                            "#8c564b", "#e377c2", "#7f7f7f", "#bcbd22", "#17becf"};
+
+constexpr std::array spark_blocks{"\u2581", "\u2582", "\u2583", "\u2584",
+                                  "\u2585", "\u2586", "\u2587", "\u2588"};
+
+// Whole decades that cover [min, max]
+struct LogRange {
+  double min_decade;
+  double max_decade;
+
+  double position(double value, double length) const {
+    return (std::log10(value) - min_decade) / (max_decade - min_decade) * length;
+  }
+};
+
+LogRange log_range(double min, double max) {
+  LogRange range{std::floor(std::log10(min)), std::ceil(std::log10(max))};
+  if (range.max_decade <= range.min_decade) {
+    range.max_decade = range.min_decade + 1;
+  }
+  return range;
+}
+
+std::string escape(const std::string &text) {
+  std::string escaped;
+  for (char c : text) {
+    switch (c) {
+    case '<':
+      escaped += "&lt;";
+      break;
+    case '>':
+      escaped += "&gt;";
+      break;
+    case '&':
+      escaped += "&amp;";
+      break;
+    default:
+      escaped += c;
+      break;
+    }
+  }
+  return escaped;
+}
+
+// 1e-3 .. 1e3 are written out, the rest in exponent form
+std::string decade_label(double decade) {
+  if (decade >= -3 && decade <= 3) {
+    std::string label = std::to_string(std::pow(10, decade));
+    label.erase(label.find_last_not_of('0') + 1);
+    if (label.back() == '.') {
+      label.pop_back();
+    }
+    return label;
+  }
+  return "1e" + std::to_string(static_cast<int>(decade));
+}
+
+} // namespace
+
+void write_svg(const std::string &path, const LogLogChart &chart) {
+  double x_min = std::numeric_limits<double>::max();
+  double x_max = std::numeric_limits<double>::lowest();
+  double y_min = x_min;
+  double y_max = x_max;
+  for (const ChartSeries &series : chart.series) {
+    for (const ChartPoint &point : series.points) {
+      x_min = std::min(x_min, point.x);
+      x_max = std::max(x_max, point.x);
+      y_min = std::min(y_min, point.y);
+      y_max = std::max(y_max, point.y);
+    }
+  }
+  if (x_min > x_max) {
+    throw std::runtime_error("chart has no points");
+  }
+  const LogRange x_range = log_range(x_min, x_max);
+  const LogRange y_range = log_range(y_min, y_max);
+
+  const double plot_width = width - margin_left - margin_right;
+  const double plot_height = height - margin_top - margin_bottom;
+  auto x_position = [&](double x) { return margin_left + x_range.position(x, plot_width); };
+  auto y_position = [&](double y) { return margin_top + plot_height - y_range.position(y, plot_height); };
+
+  std::ofstream svg(path);
+  svg << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << width << "\" height=\"" << height
+      << "\" font-family=\"sans-serif\" font-size=\"12\">\n";
+  svg << "<rect width=\"100%\" height=\"100%\" fill=\"white\"/>\n";
+  svg << "<text x=\"" << width / 2 << "\" y=\"24\" text-anchor=\"middle\" font-size=\"16\">" << escape(chart.title)
+      << "</text>\n";
+
+  // Grid lines and labels at every decade
+  for (double decade = x_range.min_decade; decade <= x_range.max_decade; decade++) {
+    const double x = x_position(std::pow(10, decade));
+    svg << "<line x1=\"" << x << "\" y1=\"" << margin_top << "\" x2=\"" << x << "\" y2=\""
+        << margin_top + plot_height << "\" stroke=\"#ddd\"/>\n";
+    svg << "<text x=\"" << x << "\" y=\"" << margin_top + plot_height + 16 << "\" text-anchor=\"middle\">"
+        << decade_label(decade) << "</text>\n";
+  }
+  for (double decade = y_range.min_decade; decade <= y_range.max_decade; decade++) {
+    const double y = y_position(std::pow(10, decade));
+    svg << "<line x1=\"" << margin_left << "\" y1=\"" << y << "\" x2=\"" << margin_left + plot_width << "\" y2=\""
+        << y << "\" stroke=\"#ddd\"/>\n";
+    svg << "<text x=\"" << margin_left - 6 << "\" y=\"" << y + 4 << "\" text-anchor=\"end\">"
+        << decade_label(decade) << "</text>\n";
+  }
+  svg << "<rect x=\"" << margin_left << "\" y=\"" << margin_top << "\" width=\"" << plot_width << "\" height=\""
+      << plot_height << "\" fill=\"none\" stroke=\"black\"/>\n";
+  svg << "<text x=\"" << margin_left + plot_width / 2 << "\" y=\"" << height - 16 << "\" text-anchor=\"middle\">"
+      << escape(chart.x_label) << "</text>\n";
+  svg << "<text transform=\"translate(20 " << margin_top + plot_height / 2
+      << ") rotate(-90)\" text-anchor=\"middle\">" << escape(chart.y_label) << "</text>\n";
+
+  // Series and their legend entries
+  for (std::size_t i = 0; i < chart.series.size(); i++) {
+    const ChartSeries &series = chart.series[i];
+    const char *color = colors[i % colors.size()];
+    svg << "<polyline fill=\"none\" stroke=\"" << color << "\" stroke-width=\"2\" points=\"";
+    for (const ChartPoint &point : series.points) {
+      svg << x_position(point.x) << ',' << y_position(point.y) << ' ';
+    }
+    svg << "\"/>\n";
+    if (series.markers) {
+      for (const ChartPoint &point : series.points) {
+        svg << "<circle cx=\"" << x_position(point.x) << "\" cy=\"" << y_position(point.y) << "\" r=\"3\" fill=\""
+            << color << "\"/>\n";
+      }
+    }
+
+    const double legend_x = margin_left + plot_width + 12;
+    const double legend_y = margin_top + 12 + i * 18;
+    svg << "<line x1=\"" << legend_x << "\" y1=\"" << legend_y << "\" x2=\"" << legend_x + 20 << "\" y2=\""
+        << legend_y << "\" stroke=\"" << color << "\" stroke-width=\"2\"/>\n";
+    svg << "<text x=\"" << legend_x + 26 << "\" y=\"" << legend_y + 4 << "\">" << escape(series.label)
+        << "</text>\n";
+  }
+  svg << "</svg>\n";
+
+  if (!svg) {
+    throw std::runtime_error("unable to write " + path);
+  }
+}
+
+void set_chart_directory(std::filesystem::path directory) {
+  output_directory = std::move(directory);
+}
+
+bool charts_enabled() {
+  return !output_directory.empty();
+}
+
+void write_chart(const std::string &name, const LogLogChart &chart) {
+  if (output_directory.empty()) {
+    return;
+  }
+  const std::filesystem::path path = output_directory / name;
+  std::error_code error;
+  std::filesystem::create_directories(output_directory, error);
+  try {
+    write_svg(path.string(), chart);
+  } catch (const std::runtime_error &exception) {
+    std::cerr << "warning: " << exception.what() << '\n';
+    return;
+  }
+  std::cerr << "chart written to " << path.string() << '\n';
+}
+
+std::string sparkline(std::span<const double> values) {
+  if (values.empty()) {
+    return {};
+  }
+  const auto [min, max] = std::minmax_element(values.begin(), values.end());
+  std::string line;
+  for (double value : values) {
+    std::size_t level = spark_blocks.size() - 1;
+    if (*max > *min) {
+      level = static_cast<std::size_t>((value - *min) / (*max - *min) * (spark_blocks.size() - 1) + 0.5);
+    }
+    line += spark_blocks[level];
+  }
+  return line;
+}
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#pragma once
+
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+struct ChartPoint {
+  double x;
+  double y;
+};
+
+// A polyline through points, in order
+struct ChartSeries {
+  std::string label;
+  std::vector<ChartPoint> points;
+  // Marks every point, for measured curves rather than model lines
+  bool markers = false;
+};
+
+// Both axes are logarithmic, so every coordinate must be positive.
+struct LogLogChart {
+  std::string title;
+  std::string x_label;
+  std::string y_label;
+  std::vector<ChartSeries> series;
+};
+
+// Writes the chart as a standalone SVG file. Throws std::runtime_error if the
+// file cannot be written.
+void write_svg(const std::string &path, const LogLogChart &chart);
+
+// Directory that write_chart writes into. No charts are written until it is
+// set.
+void set_chart_directory(std::filesystem::path directory);
+bool charts_enabled();
+
+// Writes the chart as an SVG file of this name in the chart directory, if one
+// is set, and prints its path on std::cerr, so that the line is not cached
+// with the results. Warns if it cannot be written, as the results it shows
+// have been printed already.
+void write_chart(const std::string &name, const LogLogChart &chart);
+
+// One block character per value, scaled between the smallest and largest
+// value, for a quick look at a curve in the terminal
+std::string sparkline(std::span<const double> values);
@@ -0,0 +1,185 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "benchmark.hh"
+#include "hostcopy.hh"
+#include "shaders.hh"
+#include "vkcontext.hh"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+namespace {
+
+constexpr std::array copy_counts{16u, 256u, 4'096u, 65'536u};
+constexpr std::array copy_sizes{64u, 256u, 4'096u};
+
+constexpr int iteration_count = 8;
+
+// Matches CopyCommand in src/shaders/copy_list.comp
+struct CopyCommand {
+  VkDeviceAddress src;
+  VkDeviceAddress dst;
+  std::uint32_t size;
+  std::uint32_t padding;
+};
+
+struct CopyListPushConstants {
+  VkDeviceAddress list;
+  std::uint32_t count;
+};
+
+struct CopyListCost {
+  double record_seconds;
+  double gpu_seconds;
+};
+
+// Records once through record and submits iteration_count times
+template <typename Record>
+CopyListCost measure_copies(const Context &context, VkPipelineStageFlags2 stage, Record record) {
+  QueryPool query_pool = context.create_timestamp_query_pool(2);
+  Fence fence = context.create_fence();
+  CommandBuffer command_buffer = context.create_command_buffer();
+
+  Clock::time_point start = Clock::now();
+  command_buffer.begin();
+  vkCmdResetQueryPool(command_buffer.handle(), query_pool.handle(), 0, 2);
+  vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_NONE, query_pool.handle(), 0);
+  record(command_buffer);
+  vkCmdWriteTimestamp2(command_buffer.handle(), stage, query_pool.handle(), 1);
+  command_buffer.end();
+  double record_seconds = elapsed_seconds(start);
+
+  double gpu_seconds = 0;
+  for (int count = 0; count < iteration_count; count++) {
+    gpu_seconds += timed_submit(context, command_buffer, fence, query_pool);
+  }
+  return {record_seconds, gpu_seconds / iteration_count};
+}
+
+void print_cost(const char *method, std::uint64_t bytes, const CopyListCost &cost) {
+  std::cout << "  " << method << ": record " << cost.record_seconds * 1e6 << " us, gpu " << cost.gpu_seconds * 1e6
+            << " us @ " << mib_per_second(bytes, cost.gpu_seconds) << " MiB/sec\n";
+}
+
+void copy_list_case_benchmark(const Context &context, const ComputePipeline &pipeline, const Buffer &src,
+                              const Buffer &dst, std::uint32_t copy_count, std::uint32_t copy_size) {
+  // Sources are packed, destinations are scattered in a random order
+  std::vector<std::uint32_t> destination_slots(copy_count);
+  std::iota(destination_slots.begin(), destination_slots.end(), 0);
+  std::shuffle(destination_slots.begin(), destination_slots.end(), std::mt19937(copy_count));
+
+  std::vector<VkBufferCopy> regions;
+  for (std::uint32_t i = 0; i < copy_count; i++) {
+    regions.push_back({
+        .srcOffset = static_cast<VkDeviceSize>(copy_size) * i,
+        .dstOffset = static_cast<VkDeviceSize>(copy_size) * destination_slots[i],
+        .size = copy_size,
+    });
+  }
+
+  // The list lives in device memory, where a GPU producer would write it
+  const std::uint32_t list_size = copy_count * sizeof(CopyCommand);
+  Buffer list_staging = context.create_buffer(list_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+  list_staging.allocate(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  const VkDeviceAddress src_address = src.device_address();
+  const VkDeviceAddress dst_address = dst.device_address();
+  std::vector<CopyCommand> commands;
+  for (std::uint32_t i = 0; i < copy_count; i++) {
+    commands.push_back({
+        .src = src_address + regions[i].srcOffset,
+        .dst = dst_address + regions[i].dstOffset,
+        .size = copy_size,
+    });
+  }
+  host_copy(list_staging, list_staging.mmap(), {reinterpret_cast<const std::uint8_t *>(commands.data()), list_size});
+
+  Buffer list = context.create_buffer(list_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                     VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+                                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  list.allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  {
+    Fence fence = context.create_fence();
+    CommandBuffer command_buffer = context.create_command_buffer();
+    VkBufferCopy copy{
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size = list_size,
+    };
+    // Makes the list visible to the kernels that read it
+    VkMemoryBarrier2 barrier{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+    };
+    VkDependencyInfo dependency_info{
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+    };
+    command_buffer.begin();
+    vkCmdCopyBuffer(command_buffer.handle(), list_staging.handle(), list.handle(), 1, &copy);
+    vkCmdPipelineBarrier2(command_buffer.handle(), &dependency_info);
+    command_buffer.end();
+    command_buffer.submit(fence);
+    fence.wait();
+  }
+
+  const std::uint64_t total_bytes = static_cast<std::uint64_t>(copy_count) * copy_size;
+  std::cout << copy_count << " x " << copy_size << " B\n";
+
+  CopyListPushConstants push_constants{
+      .list = list.device_address(),
+      .count = copy_count,
+  };
+  print_cost("kernel", total_bytes,
+             measure_copies(context, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, [&](const CommandBuffer &command_buffer) {
+               vkCmdBindPipeline(command_buffer.handle(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.handle());
+               vkCmdPushConstants(command_buffer.handle(), pipeline.layout(), VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                  sizeof(push_constants), &push_constants);
+               vkCmdDispatch(command_buffer.handle(), std::min(copy_count, 65'535u), 1, 1);
+             }));
+
+  print_cost("multi-region copy", total_bytes,
+             measure_copies(context, VK_PIPELINE_STAGE_2_COPY_BIT, [&](const CommandBuffer &command_buffer) {
+               vkCmdCopyBuffer(command_buffer.handle(), src.handle(), dst.handle(), regions.size(), regions.data());
+             }));
+
+  print_cost("copy per region", total_bytes,
+             measure_copies(context, VK_PIPELINE_STAGE_2_COPY_BIT, [&](const CommandBuffer &command_buffer) {
+               for (const VkBufferCopy &region : regions) {
+                 vkCmdCopyBuffer(command_buffer.handle(), src.handle(), dst.handle(), 1, &region);
+               }
+             }));
+}
+
+} // namespace
+
+void copy_list_benchmark(Context &context) {
+  ComputePipeline pipeline = context.create_compute_pipeline(shaders::copy_list, sizeof(CopyListPushConstants));
+
+  const std::uint32_t buffer_size =
+      *std::max_element(copy_counts.begin(), copy_counts.end()) * *std::max_element(copy_sizes.begin(), copy_sizes.end());
+  const VkBufferUsageFlags usage =
+      VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  Buffer src = context.create_buffer(buffer_size, usage);
+  src.allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  Buffer dst = context.create_buffer(buffer_size, usage);
+  dst.allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  std::cout << "scattered copy list (device-to-device)\n--------------------\n";
+  for (std::uint32_t copy_count : copy_counts) {
+    for (std::uint32_t copy_size : copy_sizes) {
+      copy_list_case_benchmark(context, pipeline, src, dst, copy_count, copy_size);
+    }
+  }
+  print_pipeline_statistics("kernel", pipeline.executables());
+}
@@ -0,0 +1,277 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "environment.hh"
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <dlfcn.h>
+#include <sys/utsname.h>
+#include <vulkan/vulkan_core.h>
+
+namespace {
+
+// Shared objects that are Vulkan drivers rather than the loader or layers
+constexpr std::array driver_library_names{"libvulkan_", "amdvlk", "libGLX_nvidia", "libnvidia-vulkan"};
+
+// Shared objects of layers, and the validation layer among them
+constexpr std::string_view layer_library_prefix = "libVkLayer_";
+constexpr std::string_view validation_library_name = "libVkLayer_khronos_validation.so";
+
+// Environment variables that change which drivers and layers the loader uses
+constexpr std::array loader_variables{"VK_ICD_FILENAMES", "VK_DRIVER_FILES", "VK_ADD_DRIVER_FILES",
+                                      "VK_INSTANCE_LAYERS", "VK_LOADER_LAYERS_ENABLE", "VK_LOADER_LAYERS_DISABLE"};
+
+// First line of a sysfs or procfs file
+std::optional<std::string> read_line(const std::filesystem::path &path) {
+  std::ifstream file(path);
+  std::string line;
+  if (!std::getline(file, line)) {
+    return std::nullopt;
+  }
+  return line;
+}
+
+// Value of the first "key : value" line of /proc/cpuinfo with this key
+std::optional<std::string> cpuinfo_value(std::string_view key) {
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.starts_with(key)) {
+      std::size_t colon = line.find(':');
+      if (colon != std::string::npos && colon + 2 <= line.size()) {
+        return line.substr(colon + 2);
+      }
+    }
+  }
+  return std::nullopt;
+}
+
+// The line marked with '*' in an amdgpu pp_dpm_* file, which is the current
+// clock level
+std::optional<std::string> current_dpm_level(const std::filesystem::path &path) {
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.ends_with('*')) {
+      return line;
+    }
+  }
+  return std::nullopt;
+}
+
+std::string version_string(std::uint32_t version) {
+  return std::to_string(VK_API_VERSION_MAJOR(version)) + '.' + std::to_string(VK_API_VERSION_MINOR(version)) + '.' +
+         std::to_string(VK_API_VERSION_PATCH(version));
+}
+
+class Recorder {
+public:
+  explicit Recorder(Environment &environment) : m_environment(environment) {}
+
+  void add(std::string name, std::string value) {
+    m_environment.entries.push_back({std::move(name), std::move(value)});
+  }
+  void add(std::string name, const std::optional<std::string> &value) {
+    if (value) {
+      add(std::move(name), *value);
+    }
+  }
+  void warn(std::string warning) { m_environment.warnings.push_back(std::move(warning)); }
+
+private:
+  Environment &m_environment;
+};
+
+void capture_host(Recorder &recorder) {
+  utsname name;
+  if (uname(&name) == 0) {
+    recorder.add("kernel", std::string(name.release) + ' ' + name.version + ' ' + name.machine);
+  }
+  recorder.add("kernel_command_line", read_line("/proc/cmdline"));
+  recorder.add("cpu_model", cpuinfo_value("model name"));
+
+  // Governors can differ between CPUs, so list every distinct one
+  std::set<std::string> governors;
+  for (int cpu = 0;; cpu++) {
+    const std::filesystem::path cpufreq = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cpufreq";
+    std::optional<std::string> governor = read_line(cpufreq / "scaling_governor");
+    if (!governor) {
+      break;
+    }
+    governors.insert(*governor);
+  }
+  std::string governor_list;
+  for (const std::string &governor : governors) {
+    governor_list += (governor_list.empty() ? "" : ",") + governor;
+  }
+  if (!governor_list.empty()) {
+    recorder.add("cpu_governor", governor_list);
+  }
+  if (governors.contains("powersave")) {
+    recorder.warn("CPU frequency governor is powersave, submission and host copy times will vary");
+  }
+
+  const std::filesystem::path cpu0 = "/sys/devices/system/cpu/cpu0/cpufreq";
+  recorder.add("cpu0_frequency_khz", read_line(cpu0 / "scaling_cur_freq"));
+  recorder.add("cpu0_max_frequency_khz", read_line(cpu0 / "scaling_max_freq"));
+  recorder.add("cpu_boost", read_line("/sys/devices/system/cpu/cpufreq/boost"));
+  recorder.add("intel_pstate_no_turbo", read_line("/sys/devices/system/cpu/intel_pstate/no_turbo"));
+
+  // Any entry means an IOMMU is active. Whether it translates the device's
+  // DMA is in the device's iommu_group.
+  std::error_code error;
+  const bool iommu = std::filesystem::directory_iterator("/sys/class/iommu", error) !=
+                     std::filesystem::directory_iterator();
+  recorder.add("iommu", std::string(!error && iommu ? "present" : "absent"));
+}
+
+void capture_device(Recorder &recorder, const Context &context) {
+  VkPhysicalDevicePCIBusInfoPropertiesEXT pci_bus_info{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PCI_BUS_INFO_PROPERTIES_EXT,
+  };
+  VkPhysicalDeviceDriverProperties driver_properties{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DRIVER_PROPERTIES,
+      .pNext = context.has_extension(VK_EXT_PCI_BUS_INFO_EXTENSION_NAME) ? &pci_bus_info : nullptr,
+  };
+  VkPhysicalDeviceProperties2 properties{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+      .pNext = &driver_properties,
+  };
+  vkGetPhysicalDeviceProperties2(context.physical_device(), &properties);
+
+  recorder.add("device", std::string(properties.properties.deviceName));
+  recorder.add("device_api_version", version_string(properties.properties.apiVersion));
+  recorder.add("driver_id", std::to_string(driver_properties.driverID));
+  recorder.add("driver_name", std::string(driver_properties.driverName));
+  recorder.add("driver_info", std::string(driver_properties.driverInfo));
+  recorder.add("driver_version", std::to_string(properties.properties.driverVersion));
+  const VkConformanceVersion &conformance = driver_properties.conformanceVersion;
+  recorder.add("driver_conformance_version", std::to_string(conformance.major) + '.' +
+                                                 std::to_string(conformance.minor) + '.' +
+                                                 std::to_string(conformance.subminor) + '.' +
+                                                 std::to_string(conformance.patch));
+
+  if (!context.has_extension(VK_EXT_PCI_BUS_INFO_EXTENSION_NAME)) {
+    return;
+  }
+  char address[16];
+  std::snprintf(address, sizeof(address), "%04x:%02x:%02x.%x", pci_bus_info.pciDomain, pci_bus_info.pciBus,
+                pci_bus_info.pciDevice, pci_bus_info.pciFunction);
+  recorder.add("pci_address", std::string(address));
+
+  const std::filesystem::path pci_device = std::filesystem::path("/sys/bus/pci/devices") / address;
+  std::optional<std::string> link_speed = read_line(pci_device / "current_link_speed");
+  std::optional<std::string> max_link_speed = read_line(pci_device / "max_link_speed");
+  std::optional<std::string> link_width = read_line(pci_device / "current_link_width");
+  std::optional<std::string> max_link_width = read_line(pci_device / "max_link_width");
+  recorder.add("pcie_link_speed", link_speed);
+  recorder.add("pcie_max_link_speed", max_link_speed);
+  recorder.add("pcie_link_width", link_width);
+  recorder.add("pcie_max_link_width", max_link_width);
+  // Idle links may train down to save power and come back up under load
+  if ((link_speed && max_link_speed && *link_speed != *max_link_speed) ||
+      (link_width && max_link_width && *link_width != *max_link_width)) {
+    recorder.warn("PCIe link is below its maximum speed or width, host-device copies may be slower");
+  }
+
+  // identity means DMA bypasses translation (iommu=pt), DMA or DMA-FQ means
+  // it is translated
+  recorder.add("iommu_domain", read_line(pci_device / "iommu_group" / "type"));
+
+  // Only amdgpu exposes its clock levels this way
+  recorder.add("gpu_core_clock", current_dpm_level(pci_device / "pp_dpm_sclk"));
+  recorder.add("gpu_memory_clock", current_dpm_level(pci_device / "pp_dpm_mclk"));
+  recorder.add("gpu_performance_level", read_line(pci_device / "power_dpm_force_performance_level"));
+}
+
+void capture_loader(Recorder &recorder, const Context &context) {
+  std::uint32_t loader_version;
+  if (vkEnumerateInstanceVersion(&loader_version) == VK_SUCCESS) {
+    recorder.add("loader_version", version_string(loader_version));
+  }
+  Dl_info loader;
+  if (dladdr(reinterpret_cast<const void *>(&vkCreateInstance), &loader) && loader.dli_fname) {
+    recorder.add("loader", std::string(loader.dli_fname));
+  }
+
+  // The loader does not say which driver and layers it picked, but they are
+  // mapped into the process by now. Implicit layers, such as overlays, are
+  // loaded without being asked for.
+  std::set<std::string> drivers;
+  std::set<std::string> layers;
+  std::ifstream maps("/proc/self/maps");
+  std::string line;
+  while (std::getline(maps, line)) {
+    const std::size_t path_start = line.find('/');
+    if (path_start == std::string::npos) {
+      continue;
+    }
+    const std::string path = line.substr(path_start);
+    const std::string file_name = std::filesystem::path(path).filename().string();
+    for (const char *name : driver_library_names) {
+      if (file_name.starts_with(name)) {
+        drivers.insert(path);
+      }
+    }
+    if (file_name.starts_with(layer_library_prefix)) {
+      layers.insert(path);
+    }
+  }
+  for (const std::string &driver : drivers) {
+    recorder.add("driver_library", driver);
+  }
+  bool other_layers = false;
+  for (const std::string &layer : layers) {
+    recorder.add("layer_library", layer);
+    other_layers = other_layers || !layer.ends_with(validation_library_name);
+  }
+  if (other_layers) {
+    recorder.warn("layers other than validation are loaded, they intercept Vulkan calls");
+  }
+
+  for (const char *variable : loader_variables) {
+    if (const char *value = std::getenv(variable)) {
+      recorder.add(variable, std::string(value));
+    }
+  }
+
+  recorder.add("validation", std::string(context.validation_enabled() ? "enabled" : "disabled"));
+  if (context.validation_enabled()) {
+    recorder.warn("validation layer is enabled, CPU-side timings include its checks");
+  }
+  if (std::getenv("VK_INSTANCE_LAYERS") || std::getenv("VK_LOADER_LAYERS_ENABLE")) {
+    recorder.warn("extra layers are enabled through the environment");
+  }
+}
+
+} // namespace
+
+Environment capture_environment(const Context &context) {
+  Environment environment;
+  Recorder recorder(environment);
+  capture_host(recorder);
+  capture_device(recorder, context);
+  capture_loader(recorder, context);
+  return environment;
+}
+
+void print_environment(const Environment &environment, std::ostream &stream) {
+  stream << "environment\n--------------------\n";
+  for (const EnvironmentEntry &entry : environment.entries) {
+    stream << entry.name << ": " << entry.value << '\n';
+  }
+  for (const std::string &warning : environment.warnings) {
+    stream << "warning: " << warning << '\n';
+  }
+}
@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#pragma once
+
+#include "vkcontext.hh"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct EnvironmentEntry {
+  std::string name;
+  std::string value;
+};
+
+// The state of the machine that results depend on, printed with every run so
+// that two runs can be told apart later
+struct Environment {
+  std::vector<EnvironmentEntry> entries;
+  // Conditions that are known to skew results
+  std::vector<std::string> warnings;
+};
+
+// Reads the kernel, CPU, PCIe, IOMMU and Vulkan driver state that is readable
+// without privileges. Whatever cannot be read is left out.
+Environment capture_environment(const Context &context);
+
+void print_environment(const Environment &environment, std::ostream &stream);
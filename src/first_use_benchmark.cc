@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "benchmark.hh"
+#include "hostcopy.hh"
+#include "vkcontext.hh"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+namespace {
+
+constexpr std::array buffer_sizes{1ull * 1024 * 1024, 16ull * 1024 * 1024, 256ull * 1024 * 1024};
+
+struct DestinationType {
+  const char *name;
+  std::uint32_t flags;
+};
+
+constexpr std::array destination_types{
+    DestinationType{"device-local", VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT},
+    DestinationType{"device-local host-visible", VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT},
+    DestinationType{"host-visible", VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT},
+};
+
+constexpr int steady_iteration_count = 16;
+
+struct SubmitTimes {
+  double gpu_seconds;
+  // From submit until the fence is seen, which includes any work the kernel
+  // driver does to back the memory
+  double wall_seconds;
+};
+
+SubmitTimes measure_submit(const Context &context, const CommandBuffer &command_buffer, const Fence &fence,
+                           const QueryPool &query_pool) {
+  Clock::time_point start = Clock::now();
+  double gpu_seconds = timed_submit(context, command_buffer, fence, query_pool);
+  return {gpu_seconds, elapsed_seconds(start)};
+}
+
+// Times the transfer commands of record, which run in stage
+template <typename Record>
+void record_timed(const CommandBuffer &command_buffer, const QueryPool &query_pool, VkPipelineStageFlags2 stage,
+                  Record record) {
+  command_buffer.begin();
+  // Orders the writes after those of earlier submissions to the same
+  // destination, such as the fill before the first copy
+  VkMemoryBarrier2 barrier{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+      .srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+      .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+      .dstStageMask = stage,
+      .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+  };
+  VkDependencyInfo dependency_info{
+      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .memoryBarrierCount = 1,
+      .pMemoryBarriers = &barrier,
+  };
+  vkCmdPipelineBarrier2(command_buffer.handle(), &dependency_info);
+  vkCmdResetQueryPool(command_buffer.handle(), query_pool.handle(), 0, 2);
+  vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_NONE, query_pool.handle(), 0);
+  record();
+  vkCmdWriteTimestamp2(command_buffer.handle(), stage, query_pool.handle(), 1);
+  command_buffer.end();
+}
+
+// Copies from src into a new allocation, optionally filling it first, and
+// compares the first copy with the ones after it.
+void first_use_case_benchmark(const Context &context, const Buffer &src, std::uint64_t size,
+                              const DestinationType &destination_type, bool pre_touch) {
+  Buffer dst = context.create_buffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  dst.allocate(destination_type.flags);
+
+  QueryPool query_pool = context.create_timestamp_query_pool(2);
+  Fence fence = context.create_fence();
+
+  std::cout << "  " << (pre_touch ? "pre-touched" : "fresh") << ':';
+  if (pre_touch) {
+    CommandBuffer fill_command_buffer = context.create_command_buffer();
+    record_timed(fill_command_buffer, query_pool, VK_PIPELINE_STAGE_2_CLEAR_BIT, [&] {
+      vkCmdFillBuffer(fill_command_buffer.handle(), dst.handle(), 0, VK_WHOLE_SIZE, 0);
+    });
+    SubmitTimes fill = measure_submit(context, fill_command_buffer, fence, query_pool);
+    std::cout << " fill gpu " << fill.gpu_seconds * 1e3 << " ms wall " << fill.wall_seconds * 1e3 << " ms,";
+  }
+
+  CommandBuffer command_buffer = context.create_command_buffer();
+  VkBufferCopy copy{
+      .srcOffset = 0,
+      .dstOffset = 0,
+      .size = size,
+  };
+  record_timed(command_buffer, query_pool, VK_PIPELINE_STAGE_2_COPY_BIT,
+               [&] { vkCmdCopyBuffer(command_buffer.handle(), src.handle(), dst.handle(), 1, &copy); });
+
+  SubmitTimes first = measure_submit(context, command_buffer, fence, query_pool);
+  std::vector<double> steady_gpu_seconds;
+  std::vector<double> steady_wall_seconds;
+  for (int count = 0; count < steady_iteration_count; count++) {
+    SubmitTimes steady = measure_submit(context, command_buffer, fence, query_pool);
+    steady_gpu_seconds.push_back(steady.gpu_seconds);
+    steady_wall_seconds.push_back(steady.wall_seconds);
+  }
+  const double steady_gpu = percentile(steady_gpu_seconds, 0.5);
+
+  std::cout << " first copy gpu " << first.gpu_seconds * 1e3 << " ms wall " << first.wall_seconds * 1e3
+            << " ms; steady median gpu " << steady_gpu * 1e3 << " ms wall "
+            << percentile(steady_wall_seconds, 0.5) * 1e3 << " ms; first/steady " << first.gpu_seconds / steady_gpu
+            << "x @ " << mib_per_second(size, first.gpu_seconds) << " vs " << mib_per_second(size, steady_gpu)
+            << " MiB/sec\n";
+}
+
+} // namespace
+
+void first_use_benchmark(Context &context) {
+  const std::uint64_t max_size = *std::max_element(buffer_sizes.begin(), buffer_sizes.end());
+  Buffer src = context.create_buffer(max_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+  src.allocate(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  std::span<std::uint8_t> data = src.mmap();
+  host_fill(src, data, 0xff);
+
+  // Only the destination should be cold, so the source gets read once up
+  // front
+  {
+    Buffer warm_dst = context.create_buffer(max_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    warm_dst.allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    Fence fence = context.create_fence();
+    CommandBuffer command_buffer = context.create_command_buffer();
+    VkBufferCopy copy{
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size = max_size,
+    };
+    command_buffer.begin();
+    vkCmdCopyBuffer(command_buffer.handle(), src.handle(), warm_dst.handle(), 1, &copy);
+    command_buffer.end();
+    command_buffer.submit(fence);
+    fence.wait();
+  }
+
+  std::cout << "first-use vs steady-state copy (host-to-new-allocation)\n--------------------\n";
+  for (const DestinationType &destination_type : destination_types) {
+    if (!context.has_memory_type(destination_type.flags)) {
+      std::cout << destination_type.name << ": skipped, no such memory type\n";
+      continue;
+    }
+    for (std::uint64_t size : buffer_sizes) {
+      std::cout << size / 1024 / 1024 << " MiB " << destination_type.name << '\n';
+      first_use_case_benchmark(context, src, size, destination_type, false);
+      first_use_case_benchmark(context, src, size, destination_type, true);
+    }
+  }
+}
@@ -0,0 +1,214 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "host_allocator.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Blocks of 64 B to 4 KiB, each aligned to its size
+constexpr std::size_t smallest_block_size = 64;
+constexpr std::size_t chunk_size = 1024 * 1024;
+
+// Right before every pointer handed to the driver
+struct BlockHeader {
+  // From the start of the block to the pointer
+  std::uint32_t offset;
+  // Arena size class, or -1 for the system heap
+  std::int32_t size_class;
+  std::uint64_t size;
+};
+static_assert(sizeof(BlockHeader) == 16);
+
+BlockHeader &header(void *memory) { return *(static_cast<BlockHeader *>(memory) - 1); }
+
+// Room before the pointer, which keeps it aligned. Vulkan alignments are
+// powers of two.
+std::size_t header_space(std::size_t alignment) { return std::max(sizeof(BlockHeader), alignment); }
+
+// Smallest size class that holds this many bytes, or -1 if none does
+int size_class(std::size_t bytes, std::size_t class_count) {
+  for (std::size_t i = 0; i < class_count; i++) {
+    if (bytes <= smallest_block_size << i) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+HostAllocator::HostAllocator(HostAllocatorKind kind)
+    : m_kind(kind), m_callbacks{
+                        .pUserData = this,
+                        .pfnAllocation = allocation_callback,
+                        .pfnReallocation = reallocation_callback,
+                        .pfnFree = free_callback,
+                        .pfnInternalAllocation = internal_allocation_callback,
+                        .pfnInternalFree = internal_free_callback,
+                    } {}
+
+HostAllocator::~HostAllocator() {
+  for (void *chunk : m_chunks) {
+    std::free(chunk);
+  }
+}
+
+void *HostAllocator::allocate_block(std::size_t size, std::size_t alignment) {
+  const std::size_t offset = header_space(alignment);
+  const int block_class = m_kind == HostAllocatorKind::arena ? size_class(offset + size, m_free_blocks.size()) : -1;
+
+  void *block;
+  if (block_class < 0) {
+    // aligned_alloc wants a multiple of the alignment
+    const std::size_t block_alignment = std::max(alignment, alignof(std::max_align_t));
+    const std::size_t block_size = (offset + size + block_alignment - 1) / block_alignment * block_alignment;
+    block = std::aligned_alloc(block_alignment, block_size);
+    if (!block) {
+      return nullptr;
+    }
+  } else if (void *free_block = m_free_blocks[block_class]) {
+    m_free_blocks[block_class] = *static_cast<void **>(free_block);
+    block = free_block;
+    m_totals.arena_count++;
+  } else {
+    const std::size_t block_size = smallest_block_size << block_class;
+    std::size_t start = (m_chunk_used + block_size - 1) / block_size * block_size;
+    if (m_chunks.empty() || start + block_size > chunk_size) {
+      void *chunk = std::aligned_alloc(chunk_size, chunk_size);
+      if (!chunk) {
+        return nullptr;
+      }
+      m_chunks.push_back(chunk);
+      start = 0;
+    }
+    block = static_cast<std::byte *>(m_chunks.back()) + start;
+    m_chunk_used = start + block_size;
+    m_totals.arena_count++;
+  }
+
+  void *memory = static_cast<std::byte *>(block) + offset;
+  header(memory) = {static_cast<std::uint32_t>(offset), block_class, size};
+  return memory;
+}
+
+void HostAllocator::free_block(void *memory) {
+  const BlockHeader block_header = header(memory);
+  void *block = static_cast<std::byte *>(memory) - block_header.offset;
+  if (block_header.size_class < 0) {
+    std::free(block);
+    return;
+  }
+  *static_cast<void **>(block) = m_free_blocks[block_header.size_class];
+  m_free_blocks[block_header.size_class] = block;
+}
+
+void *HostAllocator::allocate(std::size_t size, std::size_t alignment, VkSystemAllocationScope scope) {
+  const auto start = std::chrono::steady_clock::now();
+  std::lock_guard lock(m_mutex);
+  void *memory = allocate_block(size, alignment);
+  if (memory) {
+    m_totals.allocation_count++;
+    m_totals.allocated_bytes += size;
+    m_totals.scope_counts[scope]++;
+    m_totals.live_bytes += size;
+    m_totals.peak_bytes = std::max(m_totals.peak_bytes, m_totals.live_bytes);
+  } else {
+    m_totals.failed_count++;
+  }
+  m_totals.seconds += seconds_since(start);
+  return memory;
+}
+
+void *HostAllocator::reallocate(void *original, std::size_t size, std::size_t alignment,
+                                VkSystemAllocationScope scope) {
+  if (!original) {
+    return allocate(size, alignment, scope);
+  }
+  if (size == 0) {
+    free(original);
+    return nullptr;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  std::lock_guard lock(m_mutex);
+  BlockHeader &original_header = header(original);
+  const std::uint64_t original_size = original_header.size;
+  void *memory = original;
+  // Arena blocks have room up to their size class
+  if (original_header.size_class < 0 ||
+      original_header.offset + size > smallest_block_size << original_header.size_class) {
+    memory = allocate_block(size, alignment);
+    if (!memory) {
+      m_totals.failed_count++;
+      m_totals.seconds += seconds_since(start);
+      return nullptr;
+    }
+    std::memcpy(memory, original, std::min<std::uint64_t>(original_size, size));
+    free_block(original);
+  } else {
+    original_header.size = size;
+  }
+  m_totals.reallocation_count++;
+  m_totals.allocated_bytes += size;
+  m_totals.scope_counts[scope]++;
+  m_totals.live_bytes = m_totals.live_bytes - original_size + size;
+  m_totals.peak_bytes = std::max(m_totals.peak_bytes, m_totals.live_bytes);
+  m_totals.seconds += seconds_since(start);
+  return memory;
+}
+
+void HostAllocator::free(void *memory) {
+  if (!memory) {
+    return;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  std::lock_guard lock(m_mutex);
+  m_totals.free_count++;
+  m_totals.live_bytes -= header(memory).size;
+  free_block(memory);
+  m_totals.seconds += seconds_since(start);
+}
+
+void *HostAllocator::allocation_callback(void *user_data, std::size_t size, std::size_t alignment,
+                                         VkSystemAllocationScope scope) {
+  return static_cast<HostAllocator *>(user_data)->allocate(size, alignment, scope);
+}
+
+void *HostAllocator::reallocation_callback(void *user_data, void *original, std::size_t size, std::size_t alignment,
+                                           VkSystemAllocationScope scope) {
+  return static_cast<HostAllocator *>(user_data)->reallocate(original, size, alignment, scope);
+}
+
+void HostAllocator::free_callback(void *user_data, void *memory) {
+  static_cast<HostAllocator *>(user_data)->free(memory);
+}
+
+void HostAllocator::internal_allocation_callback(void *user_data, std::size_t size, VkInternalAllocationType,
+                                                 VkSystemAllocationScope) {
+  HostAllocator &allocator = *static_cast<HostAllocator *>(user_data);
+  std::lock_guard lock(allocator.m_mutex);
+  allocator.m_totals.internal_count++;
+  allocator.m_totals.internal_bytes += size;
+}
+
+void HostAllocator::internal_free_callback(void *, std::size_t, VkInternalAllocationType, VkSystemAllocationScope) {}
+
+void HostAllocator::reset() {
+  std::lock_guard lock(m_mutex);
+  const std::uint64_t live_bytes = m_totals.live_bytes;
+  m_totals = {};
+  m_totals.live_bytes = live_bytes;
+  m_totals.peak_bytes = live_bytes;
+}
+
+HostAllocationTotals HostAllocator::totals() const {
+  std::lock_guard lock(m_mutex);
+  return m_totals;
+}
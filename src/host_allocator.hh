@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+enum class HostAllocatorKind {
+  // Counts and times allocations, which go to the system heap
+  counting,
+  // Counts too, but serves small allocations from free lists of size classes
+  // carved out of large chunks, so that churn does not reach the system heap
+  arena,
+};
+
+struct HostAllocationTotals {
+  std::uint64_t allocation_count = 0;
+  std::uint64_t reallocation_count = 0;
+  std::uint64_t free_count = 0;
+  std::uint64_t failed_count = 0;
+  std::uint64_t allocated_bytes = 0;
+  // Allocations and reallocations by VkSystemAllocationScope
+  std::array<std::uint64_t, 5> scope_counts{};
+  // Allocations and reallocations the arena served without the system heap
+  std::uint64_t arena_count = 0;
+  // Time spent in the callbacks, including waiting for other threads
+  double seconds = 0;
+  // Allocations the driver made itself and only reported
+  std::uint64_t internal_count = 0;
+  std::uint64_t internal_bytes = 0;
+  // Bytes requested through the callbacks and not freed, as of the last
+  // event
+  std::uint64_t live_bytes = 0;
+  std::uint64_t peak_bytes = 0;
+};
+
+// VkAllocationCallbacks for the driver's host memory. The driver can allocate
+// from any thread. Must outlive every object created with the callbacks.
+class HostAllocator {
+  const HostAllocatorKind m_kind;
+  VkAllocationCallbacks m_callbacks;
+  mutable std::mutex m_mutex;
+  HostAllocationTotals m_totals;
+  // Arena only: free blocks of each size class, linked through their first
+  // bytes, and the chunks they were carved from
+  std::array<void *, 7> m_free_blocks{};
+  std::vector<void *> m_chunks;
+  std::size_t m_chunk_used = 0;
+
+  void *allocate(std::size_t size, std::size_t alignment, VkSystemAllocationScope scope);
+  void *reallocate(void *original, std::size_t size, std::size_t alignment, VkSystemAllocationScope scope);
+  void free(void *memory);
+  void *allocate_block(std::size_t size, std::size_t alignment);
+  void free_block(void *memory);
+
+  static VKAPI_ATTR void *VKAPI_CALL allocation_callback(void *user_data, std::size_t size, std::size_t alignment,
+                                                         VkSystemAllocationScope scope);
+  static VKAPI_ATTR void *VKAPI_CALL reallocation_callback(void *user_data, void *original, std::size_t size,
+                                                           std::size_t alignment, VkSystemAllocationScope scope);
+  static VKAPI_ATTR void VKAPI_CALL free_callback(void *user_data, void *memory);
+  static VKAPI_ATTR void VKAPI_CALL internal_allocation_callback(void *user_data, std::size_t size,
+                                                                 VkInternalAllocationType type,
+                                                                 VkSystemAllocationScope scope);
+  static VKAPI_ATTR void VKAPI_CALL internal_free_callback(void *user_data, std::size_t size,
+                                                           VkInternalAllocationType type,
+                                                           VkSystemAllocationScope scope);
+
+public:
+  explicit HostAllocator(HostAllocatorKind kind);
+  HostAllocator(const HostAllocator &) = delete;
+  HostAllocator(HostAllocator &&) = delete;
+  ~HostAllocator();
+
+  const VkAllocationCallbacks *callbacks() const { return &m_callbacks; }
+  HostAllocatorKind kind() const { return m_kind; }
+
+  // Starts a new phase: clears the counters and restarts the peak from the
+  // bytes that are live now
+  void reset();
+  HostAllocationTotals totals() const;
+};
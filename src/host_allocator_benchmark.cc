@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "benchmark.hh"
+#include "host_allocator.hh"
+#include "vkcontext.hh"
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+namespace {
+
+struct AllocatorCase {
+  const char *name;
+  // Empty for the driver's own allocator
+  std::optional<HostAllocatorKind> kind;
+};
+
+constexpr std::array allocator_cases{
+    AllocatorCase{"driver", std::nullopt},
+    AllocatorCase{"counting", HostAllocatorKind::counting},
+    AllocatorCase{"arena", HostAllocatorKind::arena},
+};
+
+constexpr int iteration_count = 256;
+// Fills and barriers per command buffer, about as many commands as a busy
+// frame records
+constexpr int command_count = 512;
+constexpr VkDeviceSize fill_size = 256;
+constexpr VkDeviceSize buffer_size = command_count * fill_size;
+
+// The API calls that a frame makes for one command buffer
+enum Call { allocate_call, record_call, submit_call, free_call, call_count };
+
+constexpr std::array<const char *, call_count> call_names{"allocate", "record", "submit", "free"};
+
+struct CallStats {
+  std::vector<double> seconds;
+  std::uint64_t host_allocations = 0;
+  double callback_seconds = 0;
+};
+
+std::uint64_t host_allocations(const HostAllocationTotals &totals) {
+  return totals.allocation_count + totals.reallocation_count + totals.free_count;
+}
+
+void record(const CommandBuffer &command_buffer, const Buffer &buffer) {
+  command_buffer.begin();
+  for (int i = 0; i < command_count; i++) {
+    vkCmdFillBuffer(command_buffer.handle(), buffer.handle(), i * fill_size, fill_size, i);
+    VkMemoryBarrier2 barrier{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+    };
+    VkDependencyInfo dependency_info{
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+    };
+    vkCmdPipelineBarrier2(command_buffer.handle(), &dependency_info);
+  }
+  command_buffer.end();
+}
+
+void allocator_case_benchmark(const Context &parent, const AllocatorCase &allocator_case) {
+  // Declared first, as it must outlive the context
+  std::optional<HostAllocator> allocator;
+  if (allocator_case.kind) {
+    allocator.emplace(*allocator_case.kind);
+  }
+  // Allocation callbacks are fixed at device creation, so each case gets its
+  // own device
+  Context context(parent.validation_enabled(), parent.robustness(), allocator ? allocator->callbacks() : nullptr);
+  std::cout << allocator_case.name << '\n';
+  if (allocator) {
+    const HostAllocationTotals totals = allocator->totals();
+    std::cout << "  instance and device creation: " << host_allocations(totals) << " host allocations, peak "
+              << totals.peak_bytes / 1024 << " KiB\n";
+  }
+
+  Buffer buffer = context.create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  buffer.allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  Fence fence = context.create_fence();
+
+  std::array<CallStats, call_count> stats;
+  HostAllocationTotals totals = allocator ? allocator->totals() : HostAllocationTotals{};
+  Clock::time_point start;
+  // Ends a call that started at start
+  auto end_call = [&](Call call, int iteration) {
+    const double seconds = elapsed_seconds(start);
+    if (iteration < 0) {
+      return;
+    }
+    stats[call].seconds.push_back(seconds);
+    if (allocator) {
+      const HostAllocationTotals after = allocator->totals();
+      stats[call].host_allocations += host_allocations(after) - host_allocations(totals);
+      stats[call].callback_seconds += after.seconds - totals.seconds;
+      totals = after;
+    }
+  };
+
+  // The first iteration warms up the pool and is not counted
+  for (int iteration = -1; iteration < iteration_count; iteration++) {
+    if (allocator) {
+      totals = allocator->totals();
+    }
+    start = Clock::now();
+    std::unique_ptr<CommandBuffer> command_buffer(new CommandBuffer(context.create_command_buffer()));
+    end_call(allocate_call, iteration);
+
+    start = Clock::now();
+    record(*command_buffer, buffer);
+    end_call(record_call, iteration);
+
+    start = Clock::now();
+    command_buffer->submit(fence);
+    end_call(submit_call, iteration);
+
+    fence.wait();
+    fence.reset();
+    if (allocator) {
+      totals = allocator->totals();
+    }
+    start = Clock::now();
+    command_buffer.reset();
+    end_call(free_call, iteration);
+  }
+
+  for (int call = 0; call < call_count; call++) {
+    const CallStats &call_stats = stats[call];
+    std::cout << "  " << call_names[call] << ": p50 " << percentile(call_stats.seconds, 0.5) * 1e6 << " us, p99 "
+              << percentile(call_stats.seconds, 0.99) * 1e6 << " us";
+    if (allocator) {
+      std::cout << ", " << static_cast<double>(call_stats.host_allocations) / iteration_count
+                << " host allocations (" << call_stats.callback_seconds / iteration_count * 1e6
+                << " us in callbacks)";
+    }
+    std::cout << '\n';
+  }
+  if (allocator_case.kind == HostAllocatorKind::arena) {
+    std::cout << "  " << allocator->totals().arena_count << " allocations served by the arena since creation\n";
+  }
+  parent.add_footprint(context.footprint());
+}
+
+} // namespace
+
+void host_allocator_benchmark(Context &context) {
+  std::cout << "host allocation callbacks (" << command_count << " fills and barriers, " << iteration_count
+            << " command buffers)\n--------------------\n";
+  for (const AllocatorCase &allocator_case : allocator_cases) {
+    allocator_case_benchmark(context, allocator_case);
+  }
+}
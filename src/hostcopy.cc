@@ -0,0 +1,282 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "hostcopy.hh"
+#include "benchmark.hh"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+namespace {
+
+struct SizeClass {
+  // Largest size in the class
+  std::size_t max_size;
+  // Size the variants are timed at
+  std::size_t tune_size;
+};
+
+constexpr std::array size_classes{
+    SizeClass{16 * 1024, 4 * 1024},
+    SizeClass{256 * 1024, 64 * 1024},
+    SizeClass{4 * 1024 * 1024, 1024 * 1024},
+    SizeClass{std::numeric_limits<std::size_t>::max(), 8 * 1024 * 1024},
+};
+
+// Below this, starting threads costs more than they can gain
+constexpr std::size_t min_threaded_size = 1024 * 1024;
+// Threads start at page boundaries
+constexpr std::size_t thread_chunk_alignment = 4096;
+constexpr int max_thread_count = 4;
+
+// The fastest of this many runs counts, after one to warm up
+constexpr int tune_run_count = 3;
+
+constexpr std::size_t prefetch_distance = 512;
+
+template <typename Word, int Unroll, bool NonTemporal, std::size_t PrefetchDistance>
+constexpr HostCopyVariant variant() {
+  return {sizeof(Word),
+          Unroll,
+          NonTemporal,
+          PrefetchDistance,
+          copy_words<Word, Unroll, NonTemporal, PrefetchDistance>,
+          fill_words<Word, Unroll, NonTemporal>};
+}
+
+template <typename Word> void add_word_variants(std::vector<HostCopyVariant> &variants) {
+  variants.push_back(variant<Word, 1, false, 0>());
+  variants.push_back(variant<Word, 4, false, 0>());
+  variants.push_back(variant<Word, 4, false, prefetch_distance>());
+  if constexpr (non_temporal_stores_supported) {
+    variants.push_back(variant<Word, 1, true, 0>());
+    variants.push_back(variant<Word, 4, true, 0>());
+    variants.push_back(variant<Word, 4, true, prefetch_distance>());
+  }
+}
+
+const std::vector<HostCopyVariant> &host_copy_variants() {
+  static const std::vector<HostCopyVariant> variants = [] {
+    std::vector<HostCopyVariant> variants;
+    add_word_variants<std::uint32_t>(variants);
+    add_word_variants<std::uint64_t>(variants);
+#if defined(__SSE2__)
+    add_word_variants<Vector128>(variants);
+#endif
+#if defined(__AVX__)
+    add_word_variants<Vector256>(variants);
+#endif
+    return variants;
+  }();
+  return variants;
+}
+
+struct Choice {
+  const HostCopyVariant *variant = nullptr;
+  int thread_count = 1;
+  double mib_per_second = 0;
+};
+
+struct MemoryTypeSelection {
+  std::uint32_t flags;
+  std::array<Choice, size_classes.size()> copy;
+  std::array<Choice, size_classes.size()> fill;
+};
+
+// By memory type index, empty until tune_host_copy
+std::map<std::uint32_t, MemoryTypeSelection> selections;
+bool tuned = false;
+
+std::size_t size_class(std::size_t size) {
+  std::size_t index = 0;
+  while (size > size_classes[index].max_size) {
+    index++;
+  }
+  return index;
+}
+
+// Runs kernel(offset, size) over page-aligned chunks of size bytes, one per
+// thread, with the last one on the calling thread
+template <typename Kernel> void run_threaded(int thread_count, std::size_t size, Kernel kernel) {
+  const std::size_t chunk =
+      (size / thread_count + thread_chunk_alignment - 1) / thread_chunk_alignment * thread_chunk_alignment;
+  std::vector<std::jthread> threads;
+  std::size_t offset = 0;
+  for (int thread = 0; thread < thread_count - 1 && offset + chunk < size; thread++, offset += chunk) {
+    threads.emplace_back(kernel, offset, chunk);
+  }
+  kernel(offset, size - offset);
+}
+
+void run_copy(const Choice &choice, std::uint8_t *dst, const std::uint8_t *src, std::size_t size) {
+  if (choice.thread_count == 1) {
+    choice.variant->copy(dst, src, size);
+    return;
+  }
+  run_threaded(choice.thread_count, size, [&](std::size_t offset, std::size_t chunk) {
+    choice.variant->copy(dst + offset, src + offset, chunk);
+  });
+}
+
+void run_fill(const Choice &choice, std::uint8_t *dst, std::uint8_t value, std::size_t size) {
+  if (choice.thread_count == 1) {
+    choice.variant->fill(dst, value, size);
+    return;
+  }
+  run_threaded(choice.thread_count, size,
+               [&](std::size_t offset, std::size_t chunk) { choice.variant->fill(dst + offset, value, chunk); });
+}
+
+// Bandwidth of the fastest run
+template <typename Run> double tune_mib_per_second(std::size_t size, Run run) {
+  run();
+  double seconds = std::numeric_limits<double>::infinity();
+  for (int count = 0; count < tune_run_count; count++) {
+    const Clock::time_point start = Clock::now();
+    run();
+    seconds = std::min(seconds, elapsed_seconds(start));
+  }
+  return mib_per_second(size, seconds);
+}
+
+MemoryTypeSelection tune_memory_type(std::uint32_t flags, std::span<std::uint8_t> mapped,
+                                     std::span<const std::uint8_t> src) {
+  const int thread_count = std::clamp(static_cast<int>(std::thread::hardware_concurrency() / 2), 1, max_thread_count);
+  MemoryTypeSelection selection{.flags = flags};
+  for (std::size_t index = 0; index < size_classes.size(); index++) {
+    const std::size_t size = size_classes[index].tune_size;
+    std::vector<int> thread_counts{1};
+    if (thread_count > 1 && size >= min_threaded_size) {
+      thread_counts.push_back(thread_count);
+    }
+    for (const HostCopyVariant &variant : host_copy_variants()) {
+      for (int threads : thread_counts) {
+        Choice candidate{&variant, threads};
+        candidate.mib_per_second =
+            tune_mib_per_second(size, [&] { run_copy(candidate, mapped.data(), src.data(), size); });
+        if (candidate.mib_per_second > selection.copy[index].mib_per_second) {
+          selection.copy[index] = candidate;
+        }
+        // Fills have nothing to prefetch
+        if (variant.prefetch_distance != 0) {
+          continue;
+        }
+        candidate.mib_per_second = tune_mib_per_second(size, [&] { run_fill(candidate, mapped.data(), 0xff, size); });
+        if (candidate.mib_per_second > selection.fill[index].mib_per_second) {
+          selection.fill[index] = candidate;
+        }
+      }
+    }
+  }
+  return selection;
+}
+
+std::string memory_property_names(std::uint32_t flags) {
+  std::string names;
+  for (const auto &[bit, name] : {std::pair{VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "device-local"},
+                                  std::pair{VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, "host-visible"},
+                                  std::pair{VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "host-coherent"},
+                                  std::pair{VK_MEMORY_PROPERTY_HOST_CACHED_BIT, "host-cached"}}) {
+    if (flags & bit) {
+      names += (names.empty() ? "" : " ") + std::string(name);
+    }
+  }
+  return names;
+}
+
+std::string size_name(std::size_t size) {
+  return size >= 1024 * 1024 ? std::to_string(size / 1024 / 1024) + " MiB" : std::to_string(size / 1024) + " KiB";
+}
+
+void print_choice(const char *label, const Choice &choice, bool copy) {
+  const HostCopyVariant &variant = *choice.variant;
+  std::cout << label << ' ' << variant.word_size << " B x" << variant.unroll
+            << (variant.non_temporal ? " non-temporal" : "");
+  if (copy && variant.prefetch_distance) {
+    std::cout << " prefetch " << variant.prefetch_distance;
+  }
+  if (choice.thread_count > 1) {
+    std::cout << ' ' << choice.thread_count << " threads";
+  }
+  std::cout << " @ " << choice.mib_per_second << " MiB/sec";
+}
+
+} // namespace
+
+void tune_host_copy(const Context &context) {
+  VkPhysicalDeviceMemoryProperties properties;
+  vkGetPhysicalDeviceMemoryProperties(context.physical_device(), &properties);
+  const std::size_t tune_size = size_classes.back().tune_size;
+  const std::vector<std::uint8_t> src(tune_size, 0xa5);
+  const std::uint32_t type_mask =
+      context.buffer_memory_requirements(tune_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT).memoryTypeBits;
+
+  selections.clear();
+  tuned = true;
+  // Memory types with the same flags behave the same, so each set of flags is
+  // timed once
+  std::map<std::uint32_t, MemoryTypeSelection> by_flags;
+  for (std::uint32_t type = 0; type < properties.memoryTypeCount; type++) {
+    const std::uint32_t flags = properties.memoryTypes[type].propertyFlags;
+    if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0 || (type_mask & (1u << type)) == 0) {
+      continue;
+    }
+    if (!by_flags.contains(flags)) {
+      Buffer buffer = context.create_buffer(tune_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+      buffer.allocate(flags);
+      by_flags.emplace(flags, tune_memory_type(flags, buffer.mmap(), src));
+    }
+    selections.emplace(type, by_flags.at(flags));
+  }
+}
+
+bool host_copy_tuned() {
+  return tuned;
+}
+
+void print_host_copy_selection() {
+  std::cout << "host copy (" << host_copy_variants().size() << " variants)\n--------------------\n";
+  for (const auto &[type, selection] : selections) {
+    std::cout << "memory type " << type << " (" << memory_property_names(selection.flags) << ")\n";
+    for (std::size_t index = 0; index < size_classes.size(); index++) {
+      std::cout << "  ";
+      if (index + 1 < size_classes.size()) {
+        std::cout << "up to " << size_name(size_classes[index].max_size);
+      } else {
+        std::cout << "larger";
+      }
+      std::cout << ": ";
+      print_choice("copy", selection.copy[index], true);
+      std::cout << ", ";
+      print_choice("fill", selection.fill[index], false);
+      std::cout << '\n';
+    }
+  }
+}
+
+void host_copy(const Buffer &buffer, std::span<std::uint8_t> mapped, std::span<const std::uint8_t> data) {
+  assert(data.size() <= mapped.size());
+  const auto selection = selections.find(buffer.memory_type());
+  if (selection == selections.end()) {
+    std::memcpy(mapped.data(), data.data(), data.size());
+    return;
+  }
+  run_copy(selection->second.copy[size_class(data.size())], mapped.data(), data.data(), data.size());
+}
+
+void host_fill(const Buffer &buffer, std::span<std::uint8_t> mapped, std::uint8_t value) {
+  const auto selection = selections.find(buffer.memory_type());
+  if (selection == selections.end()) {
+    std::memset(mapped.data(), value, mapped.size());
+    return;
+  }
+  run_fill(selection->second.fill[size_class(mapped.size())], mapped.data(), value, mapped.size());
+}
@@ -0,0 +1,156 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#pragma once
+
+#include "vkcontext.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Copies and fills of mapped memory, with a family of store kernels that are
+// timed against each host-visible memory type before the first benchmark that
+// uses them. Write-combined memory in particular rewards wide, full-line and
+// non-temporal stores.
+
+#if defined(__SSE2__)
+constexpr bool non_temporal_stores_supported = true;
+using Vector128 = __m128i;
+#else
+constexpr bool non_temporal_stores_supported = false;
+#endif
+#if defined(__AVX__)
+using Vector256 = __m256i;
+#endif
+
+// Loads a word from any address
+template <typename Word> inline Word load_word(const void *src) {
+  Word word;
+  std::memcpy(&word, src, sizeof(Word));
+  return word;
+}
+
+// Stores a word, bypassing the caches if NonTemporal and the target has
+// non-temporal stores. Non-temporal stores need dst aligned to the word size
+// and stream_fence before the data is handed to the device.
+template <typename Word, bool NonTemporal> inline void store_word(void *dst, const Word &word) {
+#if defined(__SSE2__)
+  if constexpr (NonTemporal && sizeof(Word) == 4) {
+    _mm_stream_si32(static_cast<int *>(dst), load_word<int>(&word));
+    return;
+  } else if constexpr (NonTemporal && sizeof(Word) == 8) {
+    _mm_stream_si64(static_cast<long long *>(dst), load_word<long long>(&word));
+    return;
+  } else if constexpr (NonTemporal && sizeof(Word) == 16) {
+    _mm_stream_si128(static_cast<__m128i *>(dst), load_word<__m128i>(&word));
+    return;
+  }
+#endif
+#if defined(__AVX__)
+  if constexpr (NonTemporal && sizeof(Word) == 32) {
+    _mm256_stream_si256(static_cast<__m256i *>(dst), load_word<__m256i>(&word));
+    return;
+  }
+#endif
+  std::memcpy(dst, &word, sizeof(Word));
+}
+
+// Orders non-temporal stores before later stores, such as the one that
+// publishes the data
+inline void stream_fence() {
+#if defined(__SSE2__)
+  _mm_sfence();
+#endif
+}
+
+// Bytes before dst is aligned to Word, at most size
+template <typename Word> inline std::size_t unaligned_head(const void *dst, std::size_t size) {
+  const std::size_t misalignment = reinterpret_cast<std::uintptr_t>(dst) % sizeof(Word);
+  return misalignment ? std::min(size, sizeof(Word) - misalignment) : 0;
+}
+
+// Unroll words per iteration, with aligned stores. The source is prefetched
+// PrefetchDistance bytes ahead if that is not 0.
+template <typename Word, int Unroll, bool NonTemporal, std::size_t PrefetchDistance>
+void copy_words(void *dst, const void *src, std::size_t size) {
+  auto *d = static_cast<std::uint8_t *>(dst);
+  auto *s = static_cast<const std::uint8_t *>(src);
+  const std::size_t head = unaligned_head<Word>(d, size);
+  std::memcpy(d, s, head);
+  d += head;
+  s += head;
+  size -= head;
+
+  constexpr std::size_t step = sizeof(Word) * Unroll;
+  for (; size >= step; d += step, s += step, size -= step) {
+    if constexpr (PrefetchDistance > 0) {
+      __builtin_prefetch(s + PrefetchDistance);
+    }
+    Word words[Unroll];
+    for (int i = 0; i < Unroll; i++) {
+      words[i] = load_word<Word>(s + i * sizeof(Word));
+    }
+    for (int i = 0; i < Unroll; i++) {
+      store_word<Word, NonTemporal>(d + i * sizeof(Word), words[i]);
+    }
+  }
+  if constexpr (NonTemporal) {
+    stream_fence();
+  }
+  std::memcpy(d, s, size);
+}
+
+template <typename Word, int Unroll, bool NonTemporal>
+void fill_words(void *dst, std::uint8_t value, std::size_t size) {
+  auto *d = static_cast<std::uint8_t *>(dst);
+  const std::size_t head = unaligned_head<Word>(d, size);
+  std::memset(d, value, head);
+  d += head;
+  size -= head;
+
+  Word word;
+  std::memset(&word, value, sizeof(Word));
+  constexpr std::size_t step = sizeof(Word) * Unroll;
+  for (; size >= step; d += step, size -= step) {
+    for (int i = 0; i < Unroll; i++) {
+      store_word<Word, NonTemporal>(d + i * sizeof(Word), word);
+    }
+  }
+  if constexpr (NonTemporal) {
+    stream_fence();
+  }
+  std::memset(d, value, size);
+}
+
+// One instantiation of the kernels
+struct HostCopyVariant {
+  std::size_t word_size;
+  int unroll;
+  bool non_temporal;
+  // Copies only
+  std::size_t prefetch_distance;
+  void (*copy)(void *dst, const void *src, std::size_t size);
+  void (*fill)(void *dst, std::uint8_t value, std::size_t size);
+};
+
+// Times every variant, single and multi-threaded, against every host-visible
+// memory type of the context and keeps the fastest per memory type and size
+// class for host_copy and host_fill. The selection is process-wide, for the
+// memory types of the context's physical device.
+void tune_host_copy(const Context &context);
+// Whether tune_host_copy has run
+bool host_copy_tuned();
+
+// The selected variants and their bandwidth for each memory type and size
+// class
+void print_host_copy_selection();
+
+// Copy and fill of memory mapped from buffer, with the selected variants for
+// its memory type and size, or memcpy and memset before tune_host_copy
+void host_copy(const Buffer &buffer, std::span<std::uint8_t> mapped, std::span<const std::uint8_t> data);
+void host_fill(const Buffer &buffer, std::span<std::uint8_t> mapped, std::uint8_t value);
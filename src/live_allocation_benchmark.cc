@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "benchmark.hh"
+#include "hostcopy.hh"
+#include "vkcontext.hh"
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+namespace {
+
+constexpr std::array live_allocation_counts{0u, 100u, 1'000u, 10'000u, 100'000u};
+
+// Size of each idle allocation, and of the copy that is submitted
+constexpr std::uint32_t allocation_size = 4096;
+
+constexpr int submission_count = 256;
+
+} // namespace
+
+void live_allocation_benchmark(Context &context) {
+  VkPhysicalDeviceProperties physical_properties;
+  vkGetPhysicalDeviceProperties(context.physical_device(), &physical_properties);
+  // Leave room for the buffers used by the copy itself
+  const std::uint32_t max_live_allocations = physical_properties.limits.maxMemoryAllocationCount - 2;
+
+  Buffer src = context.create_buffer(allocation_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+  src.allocate(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  std::span<std::uint8_t> data = src.mmap();
+  host_fill(src, data, 0xff);
+
+  Buffer dst = context.create_buffer(allocation_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  dst.allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  Fence fence = context.create_fence();
+  CommandBuffer command_buffer = context.create_command_buffer();
+  VkBufferCopy copy{
+      .srcOffset = 0,
+      .dstOffset = 0,
+      .size = allocation_size,
+  };
+  command_buffer.begin();
+  vkCmdCopyBuffer(command_buffer.handle(), src.handle(), dst.handle(), 1, &copy);
+  command_buffer.end();
+
+  std::cout << "submit latency vs live allocations\n--------------------\n";
+
+  std::vector<std::unique_ptr<Buffer>> live_buffers;
+  for (std::uint32_t live_allocation_count : live_allocation_counts) {
+    if (live_allocation_count > max_live_allocations) {
+      std::cout << live_allocation_count << " allocations: skipped, exceeds maxMemoryAllocationCount ("
+                << physical_properties.limits.maxMemoryAllocationCount << ")\n";
+      continue;
+    }
+
+    while (live_buffers.size() < live_allocation_count) {
+      live_buffers.emplace_back(new Buffer(context.create_buffer(allocation_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT)));
+      live_buffers.back()->allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+
+    std::vector<double> submit_seconds;
+    std::vector<double> round_trip_seconds;
+    for (int count = 0; count < submission_count; count++) {
+      Clock::time_point start = Clock::now();
+      command_buffer.submit(fence);
+      submit_seconds.push_back(elapsed_seconds(start));
+
+      fence.wait();
+      round_trip_seconds.push_back(elapsed_seconds(start));
+      fence.reset();
+    }
+
+    std::cout << live_allocation_count << " allocations: submit median " << percentile(submit_seconds, 0.5) * 1e6
+              << " us, p99 " << percentile(submit_seconds, 0.99) * 1e6 << " us; round trip median "
+              << percentile(round_trip_seconds, 0.5) * 1e6 << " us\n";
+  }
+}
@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "benchmark.hh"
+#include "hostcopy.hh"
+#include "vkcontext.hh"
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+namespace {
+
+// Divisible by every object count below, with each object a multiple of
+// 64 bytes.
+constexpr std::uint64_t total_size = 64'000'000;
+
+constexpr int iteration_count = 8;
+
+struct ObjectCountCase {
+  std::uint32_t count;
+  // Bind every buffer to one shared allocation instead of giving each one
+  // its own.
+  bool suballocated;
+};
+
+constexpr std::array object_count_cases{
+    ObjectCountCase{1, false},      ObjectCountCase{1'000, false},   ObjectCountCase{10'000, false},
+    ObjectCountCase{100'000, false}, ObjectCountCase{100'000, true},
+};
+
+void object_count_case_benchmark(Context &context, const Buffer &src, const ObjectCountCase &object_case) {
+  const std::uint32_t object_size = total_size / object_case.count;
+
+  std::cout << object_case.count << " x " << object_size << " B" << (object_case.suballocated ? " (suballocated)" : "")
+            << '\n';
+
+  VkPhysicalDeviceProperties physical_properties;
+  vkGetPhysicalDeviceProperties(context.physical_device(), &physical_properties);
+  // The staging buffer holds one allocation too
+  if (!object_case.suballocated && object_case.count >= physical_properties.limits.maxMemoryAllocationCount) {
+    std::cout << "  skipped: exceeds maxMemoryAllocationCount (" << physical_properties.limits.maxMemoryAllocationCount
+              << ")\n";
+    return;
+  }
+
+  // Create and allocate
+  Clock::time_point start = Clock::now();
+  std::vector<std::unique_ptr<Buffer>> buffers;
+  buffers.reserve(object_case.count);
+  std::unique_ptr<Memory> memory;
+  if (object_case.suballocated) {
+    for (std::uint32_t i = 0; i < object_case.count; i++) {
+      buffers.emplace_back(new Buffer(context.create_buffer(object_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT)));
+    }
+    VkMemoryRequirements requirements = buffers.front()->memory_requirements();
+    VkDeviceSize stride = (requirements.size + requirements.alignment - 1) / requirements.alignment *
+                          requirements.alignment;
+    memory.reset(new Memory(context.allocate_memory(stride * object_case.count, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                    requirements.memoryTypeBits)));
+    for (std::uint32_t i = 0; i < object_case.count; i++) {
+      buffers[i]->bind(*memory, stride * i);
+    }
+  } else {
+    for (std::uint32_t i = 0; i < object_case.count; i++) {
+      buffers.emplace_back(new Buffer(context.create_buffer(object_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT)));
+      buffers.back()->allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+  }
+  double create_seconds = elapsed_seconds(start);
+
+  // Record one copy per object out of the shared staging buffer
+  QueryPool query_pool = context.create_timestamp_query_pool(2);
+  Fence fence = context.create_fence();
+  CommandBuffer command_buffer = context.create_command_buffer();
+
+  start = Clock::now();
+  command_buffer.begin();
+  vkCmdResetQueryPool(command_buffer.handle(), query_pool.handle(), 0, 2);
+  vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_NONE, query_pool.handle(), 0);
+  for (std::uint32_t i = 0; i < object_case.count; i++) {
+    VkBufferCopy copy{
+        .srcOffset = static_cast<VkDeviceSize>(object_size) * i,
+        .dstOffset = 0,
+        .size = object_size,
+    };
+    vkCmdCopyBuffer(command_buffer.handle(), src.handle(), buffers[i]->handle(), 1, &copy);
+  }
+  vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_COPY_BIT, query_pool.handle(), 1);
+  command_buffer.end();
+  double record_seconds = elapsed_seconds(start);
+
+  double submit_seconds = 0;
+  double gpu_seconds = 0;
+  for (int count = 0; count < iteration_count; count++) {
+    start = Clock::now();
+    command_buffer.submit(fence);
+    submit_seconds += elapsed_seconds(start);
+
+    fence.wait();
+    fence.reset();
+
+    std::vector<std::uint64_t> timestamps = query_pool.results();
+    gpu_seconds += static_cast<double>(timestamps[1] - timestamps[0]) * context.timestamp_period() / 1e9;
+  }
+
+  start = Clock::now();
+  buffers.clear();
+  memory.reset();
+  double destroy_seconds = elapsed_seconds(start);
+
+  std::cout << "  create " << create_seconds * 1e3 << " ms, record " << record_seconds * 1e3 << " ms, submit "
+            << submit_seconds / iteration_count * 1e3 << " ms, destroy " << destroy_seconds * 1e3 << " ms\n";
+  std::cout << "  copy @ " << mib_per_second(total_size * iteration_count, gpu_seconds) << " MiB/sec\n";
+}
+
+} // namespace
+
+void object_count_benchmark(Context &context) {
+  Buffer src = context.create_buffer(total_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+  src.allocate(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  std::span<std::uint8_t> data = src.mmap();
+  host_fill(src, data, 0xff);
+
+  std::cout << "object count scaling (" << total_size << " B total)\n--------------------\n";
+  for (const ObjectCountCase &object_case : object_count_cases) {
+    object_count_case_benchmark(context, src, object_case);
+  }
+}
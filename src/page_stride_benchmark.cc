@@ -0,0 +1,261 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "benchmark.hh"
+#include "chart.hh"
+#include "shaders.hh"
+#include "suite.hh"
+#include "vkcontext.hh"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+namespace {
+
+// 4 KiB and 64 KiB are common GPU page sizes, 2 MiB is the usual large page
+constexpr std::array strides{4u * 1024, 64u * 1024, 2u * 1024 * 1024, 16u * 1024 * 1024, 128u * 1024 * 1024};
+
+constexpr const char *chart_name = "page_stride.svg";
+
+constexpr VkBufferUsageFlags page_stride_usage =
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+constexpr std::uint32_t min_page_count = 16;
+constexpr VkDeviceSize min_buffer_size = 256ull * 1024 * 1024;
+
+constexpr std::uint32_t chase_load_count = 1 << 16;
+// Loads per sweep, rounded to whole passes over the pages
+constexpr std::uint64_t sweep_load_count = 1ull << 26;
+constexpr std::uint32_t sweep_group_count = 1024;
+
+// Matches the constants in src/shaders/page_stride.comp
+enum class PageStrideMode : std::uint32_t {
+  link = 0,
+  chase = 1,
+  sweep = 2,
+};
+
+struct PageStridePushConstants {
+  VkDeviceAddress base;
+  VkDeviceAddress result;
+  std::uint32_t page_count;
+  std::uint32_t stride;
+  PageStrideMode mode;
+  std::uint32_t iterations;
+};
+
+// Three quarters of the largest device-local heap, within the allocation
+// size limit, as a power of two
+VkDeviceSize largest_buffer_size(const Context &context) {
+  VkPhysicalDeviceMemoryProperties memory_properties;
+  vkGetPhysicalDeviceMemoryProperties(context.physical_device(), &memory_properties);
+  VkDeviceSize heap_size = 0;
+  for (std::uint32_t i = 0; i < memory_properties.memoryHeapCount; i++) {
+    if (memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      heap_size = std::max(heap_size, memory_properties.memoryHeaps[i].size);
+    }
+  }
+
+  VkPhysicalDeviceVulkan11Properties properties_11{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_PROPERTIES,
+  };
+  VkPhysicalDeviceProperties2 properties{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+      .pNext = &properties_11,
+  };
+  vkGetPhysicalDeviceProperties2(context.physical_device(), &properties);
+
+  return std::bit_floor(std::min(heap_size / 4 * 3, properties_11.maxMemoryAllocationSize));
+}
+
+// Records the kernel once and returns the GPU time of the last of submit_count
+// submissions
+double run_kernel(const Context &context, const ComputePipeline &pipeline, const PageStridePushConstants &push_constants,
+                  std::uint32_t group_count, int submit_count) {
+  QueryPool query_pool = context.create_timestamp_query_pool(2);
+  Fence fence = context.create_fence();
+  CommandBuffer command_buffer = context.create_command_buffer();
+
+  command_buffer.begin();
+  // Makes the links written by earlier submissions visible
+  VkMemoryBarrier2 barrier{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+      .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+      .srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT,
+      .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+      .dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT,
+  };
+  VkDependencyInfo dependency_info{
+      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .memoryBarrierCount = 1,
+      .pMemoryBarriers = &barrier,
+  };
+  vkCmdPipelineBarrier2(command_buffer.handle(), &dependency_info);
+  vkCmdResetQueryPool(command_buffer.handle(), query_pool.handle(), 0, 2);
+  vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_NONE, query_pool.handle(), 0);
+  vkCmdBindPipeline(command_buffer.handle(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.handle());
+  vkCmdPushConstants(command_buffer.handle(), pipeline.layout(), VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                     sizeof(push_constants), &push_constants);
+  vkCmdDispatch(command_buffer.handle(), group_count, 1, 1);
+  vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, query_pool.handle(), 1);
+  command_buffer.end();
+
+  double gpu_seconds = 0;
+  for (int count = 0; count < submit_count; count++) {
+    gpu_seconds = timed_submit(context, command_buffer, fence, query_pool);
+  }
+  return gpu_seconds;
+}
+
+// A step of about 0.618 of the cycle, so that consecutive loads land far
+// apart, and coprime with page_count, so that the cycle visits every page
+std::uint32_t link_step(std::uint32_t page_count) {
+  std::uint32_t step = static_cast<std::uint32_t>(page_count * 0.618) | 1;
+  while (std::gcd(step, page_count) != 1) {
+    step += 2;
+  }
+  return step % page_count;
+}
+
+// Returns the chase latency in nanoseconds
+double page_stride_case_benchmark(const Context &context, const ComputePipeline &pipeline, const Buffer &buffer,
+                                  const Buffer &result, std::uint32_t stride, std::uint32_t page_count) {
+  PageStridePushConstants push_constants{
+      .base = buffer.device_address(),
+      .result = result.device_address(),
+      .page_count = page_count,
+      .stride = stride,
+      .mode = PageStrideMode::link,
+      .iterations = link_step(page_count),
+  };
+  run_kernel(context, pipeline, push_constants, sweep_group_count, 1);
+
+  // The first chase warms up whatever fits in the TLB
+  push_constants.mode = PageStrideMode::chase;
+  push_constants.iterations = chase_load_count;
+  double chase_seconds = run_kernel(context, pipeline, push_constants, 1, 2);
+
+  push_constants.mode = PageStrideMode::sweep;
+  push_constants.iterations = std::max<std::uint64_t>(1, sweep_load_count / page_count);
+  double sweep_seconds = run_kernel(context, pipeline, push_constants, sweep_group_count, 2);
+  const std::uint64_t sweep_loads = static_cast<std::uint64_t>(page_count) * push_constants.iterations;
+
+  std::cout << "  " << page_count << " pages (" << static_cast<std::uint64_t>(page_count) * stride / 1024 / 1024
+            << " MiB): chase " << chase_seconds / chase_load_count * 1e9 << " ns/load, sweep "
+            << sweep_loads / sweep_seconds / 1e6 << " M loads/sec\n";
+  return chase_seconds / chase_load_count * 1e9;
+}
+
+// A buffer of page_count pages linked for the chase, for suite points
+struct ChaseCase {
+  ChaseCase(const Context &context, const ComputePipeline &pipeline, std::uint32_t stride, std::uint32_t page_count)
+      : context(context), pipeline(pipeline),
+        buffer(context.create_buffer(static_cast<VkDeviceSize>(page_count) * stride, page_stride_usage)),
+        result(context.create_buffer(sizeof(std::uint32_t), page_stride_usage)) {
+    buffer.allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    result.allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    push_constants = {
+        .base = buffer.device_address(),
+        .result = result.device_address(),
+        .page_count = page_count,
+        .stride = stride,
+        .mode = PageStrideMode::link,
+        .iterations = link_step(page_count),
+    };
+    run_kernel(context, pipeline, push_constants, sweep_group_count, 1);
+    push_constants.mode = PageStrideMode::chase;
+    push_constants.iterations = chase_load_count;
+  }
+
+  // GPU seconds of chase_load_count dependent loads
+  double run() const { return run_kernel(context, pipeline, push_constants, 1, 1); }
+
+  const Context &context;
+  const ComputePipeline &pipeline;
+  Buffer buffer;
+  Buffer result;
+  PageStridePushConstants push_constants;
+};
+
+} // namespace
+
+void page_stride_benchmark(Context &context) {
+  ComputePipeline pipeline = context.create_compute_pipeline(shaders::page_stride, sizeof(PageStridePushConstants));
+
+  // Allocations near the heap size can fail even when they are within the
+  // limits, so back off until one succeeds
+  std::unique_ptr<Buffer> buffer;
+  for (VkDeviceSize size = largest_buffer_size(context); size >= min_buffer_size; size /= 2) {
+    try {
+      buffer.reset(new Buffer(context.create_buffer(size, page_stride_usage)));
+      buffer->allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+      break;
+    } catch (const std::runtime_error &) {
+      buffer.reset();
+    }
+  }
+  if (!buffer) {
+    throw std::runtime_error("unable to allocate page stride buffer");
+  }
+
+  Buffer result = context.create_buffer(sizeof(std::uint32_t), page_stride_usage);
+  result.allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  LogLogChart chart{
+      .title = "Dependent load latency",
+      .x_label = "pages touched",
+      .y_label = "ns/load",
+  };
+  std::cout << "page stride (" << buffer->size() / 1024 / 1024 << " MiB buffer)\n--------------------\n";
+  for (std::uint32_t stride : strides) {
+    std::cout << stride / 1024 << " KiB stride\n";
+    ChartSeries series{std::to_string(stride / 1024) + " KiB stride", {}, true};
+    std::vector<double> latencies;
+    for (std::uint64_t page_count = min_page_count;
+         page_count * stride <= buffer->size() && page_count < (1ull << 31); page_count *= 2) {
+      latencies.push_back(page_stride_case_benchmark(context, pipeline, *buffer, result, stride, page_count));
+      series.points.push_back({static_cast<double>(page_count), latencies.back()});
+    }
+    // Steps in the curve are where the pages outgrow a TLB level
+    std::cout << "  latency " << sparkline(latencies) << '\n';
+    chart.series.push_back(std::move(series));
+  }
+  print_pipeline_statistics("kernel", pipeline.executables());
+
+  write_chart(chart_name, chart);
+}
+
+// The chase latency of every stride and page count as a point. The sweep
+// rate is left to the full benchmark. Each point allocates only the pages it
+// touches, within the heap budget.
+std::vector<SuitePoint> page_stride_points(Context &context) {
+  std::shared_ptr<ComputePipeline> pipeline(
+      new ComputePipeline(context.create_compute_pipeline(shaders::page_stride, sizeof(PageStridePushConstants))));
+  const VkDeviceSize budget = context.heap_budget(context.heap_index(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT).value());
+  const VkDeviceSize max_size = std::min(largest_buffer_size(context), std::bit_floor(budget / 4 * 3));
+  std::vector<SuitePoint> points;
+  for (std::uint32_t stride : strides) {
+    for (std::uint64_t page_count = min_page_count; page_count * stride <= max_size && page_count < (1ull << 31);
+         page_count *= 2) {
+      points.push_back({
+          .name = "page-stride " + std::to_string(stride / 1024) + " KiB x " + std::to_string(page_count) + " pages",
+          .prepare =
+              [&context, pipeline, stride, page_count] {
+                auto chase_case = std::make_shared<ChaseCase>(context, *pipeline, stride, page_count);
+                return std::function<double()>([pipeline, chase_case] { return chase_case->run(); });
+              },
+      });
+    }
+  }
+  return points;
+}
@@ -0,0 +1,214 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "benchmark.hh"
+#include "shaders.hh"
+#include "suite.hh"
+#include "vkcontext.hh"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+namespace {
+
+// Largest buffer, if the device-local heap has room for it
+constexpr std::uint32_t max_buffer_size = 1024 * 1024 * 1024;
+
+constexpr std::uint32_t chunk_size = partition_stride_chunk_size;
+constexpr std::uint32_t group_count = 1024;
+constexpr std::uint32_t group_size = 256;
+constexpr std::uint32_t chunk_count = group_count * group_size / (chunk_size / 16);
+constexpr std::uint32_t max_pass_count = 64;
+
+// Strides are swept in chunk_size steps up to fine_stride_limit, then in
+// coarse_steps steps per doubling up to max_stride. The kernel reads no line
+// twice, so large strides do not fold chunks onto addresses that are served
+// from cache.
+constexpr std::uint32_t fine_stride_limit = 64 * 1024;
+constexpr std::uint32_t coarse_steps = 32;
+constexpr std::uint32_t max_stride = 8 * 1024 * 1024;
+
+// An offset of half a chunk splits every chunk across two interleave units
+constexpr std::array offsets{0u, chunk_size / 2};
+
+constexpr VkBufferUsageFlags partition_stride_usage =
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+constexpr int iteration_count = 4;
+
+// Strides below this fraction of the median bandwidth are reported as bad
+constexpr double bad_stride_fraction = 0.5;
+
+std::vector<std::uint32_t> sweep_strides() {
+  std::vector<std::uint32_t> strides;
+  for (std::uint32_t stride = chunk_size; stride < fine_stride_limit; stride += chunk_size) {
+    strides.push_back(stride);
+  }
+  for (std::uint32_t octave = fine_stride_limit; octave < max_stride; octave *= 2) {
+    for (std::uint32_t step = 0; step < coarse_steps; step++) {
+      strides.push_back(octave + octave / coarse_steps * step);
+    }
+  }
+  strides.push_back(max_stride);
+  return strides;
+}
+
+// Three quarters of the device-local heap, at most max_buffer_size, as a
+// power of two
+std::uint32_t sweep_buffer_size(const Context &context) {
+  const VkDeviceSize heap_size = context.heap_size(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  return static_cast<std::uint32_t>(std::bit_floor(std::min<VkDeviceSize>(heap_size / 4 * 3, max_buffer_size)));
+}
+
+// Passes over the strided sequence, as many as can be read before the laps
+// would reach the next chunk and read lines again
+std::uint32_t sweep_pass_count(std::uint32_t buffer_size, std::uint32_t stride) {
+  const std::uint64_t distinct_chunks = static_cast<std::uint64_t>(stride / chunk_size) * (buffer_size / stride);
+  return static_cast<std::uint32_t>(std::min<std::uint64_t>(max_pass_count, distinct_chunks / chunk_count));
+}
+
+// The buffers of the sweep
+struct StrideBuffers {
+  StrideBuffers(const Context &context, std::uint32_t buffer_size)
+      : buffer_size(buffer_size), src(context.create_buffer(buffer_size, partition_stride_usage)),
+        dst(context.create_buffer(16, partition_stride_usage)) {
+    src.allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    dst.allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  }
+
+  std::uint32_t buffer_size;
+  Buffer src;
+  Buffer dst;
+};
+
+// Bytes read by one dispatch of a stride
+std::uint64_t stride_bytes(std::uint32_t buffer_size, std::uint32_t stride) {
+  return static_cast<std::uint64_t>(chunk_count) * chunk_size * sweep_pass_count(buffer_size, stride);
+}
+
+// A recorded dispatch of one stride and offset
+struct StrideCase {
+  StrideCase(const Context &context, const ComputePipeline &pipeline, const StrideBuffers &buffers,
+             std::uint32_t stride, std::uint32_t offset)
+      : context(context), query_pool(context.create_timestamp_query_pool(2)), fence(context.create_fence()),
+        command_buffer(context.create_command_buffer()) {
+    PartitionStridePushConstants push_constants{
+        .src = buffers.src.device_address(),
+        .dst = buffers.dst.device_address(),
+        .size_mask = buffers.buffer_size - 1,
+        .lap_chunk_count = buffers.buffer_size / stride,
+        .stride = stride,
+        .offset = offset,
+        .pass_count = sweep_pass_count(buffers.buffer_size, stride),
+    };
+
+    command_buffer.begin();
+    vkCmdResetQueryPool(command_buffer.handle(), query_pool.handle(), 0, 2);
+    vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_NONE, query_pool.handle(), 0);
+    vkCmdBindPipeline(command_buffer.handle(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.handle());
+    vkCmdPushConstants(command_buffer.handle(), pipeline.layout(), VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(push_constants), &push_constants);
+    vkCmdDispatch(command_buffer.handle(), group_count, 1, 1);
+    vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, query_pool.handle(), 1);
+    command_buffer.end();
+  }
+
+  // GPU seconds of one dispatch
+  double run() const { return timed_submit(context, command_buffer, fence, query_pool); }
+
+  const Context &context;
+  QueryPool query_pool;
+  Fence fence;
+  CommandBuffer command_buffer;
+};
+
+double stride_bandwidth(const Context &context, const ComputePipeline &pipeline, const StrideBuffers &buffers,
+                        std::uint32_t stride, std::uint32_t offset) {
+  StrideCase stride_case(context, pipeline, buffers, stride, offset);
+  double total_seconds = 0;
+  for (int count = 0; count < iteration_count; count++) {
+    total_seconds += stride_case.run();
+  }
+  return mib_per_second(stride_bytes(buffers.buffer_size, stride) * iteration_count, total_seconds);
+}
+
+// Checks that the heap has room for the largest stride
+std::uint32_t checked_buffer_size(const Context &context) {
+  const std::uint32_t buffer_size = sweep_buffer_size(context);
+  if (buffer_size < 2 * max_stride) {
+    throw std::runtime_error("device-local heap too small for the partition stride sweep");
+  }
+  return buffer_size;
+}
+
+} // namespace
+
+void partition_stride_benchmark(Context &context) {
+  ComputePipeline pipeline =
+      context.create_compute_pipeline(shaders::partition_stride, sizeof(PartitionStridePushConstants));
+
+  const std::uint32_t buffer_size = checked_buffer_size(context);
+  StrideBuffers buffers(context, buffer_size);
+
+  const std::vector<std::uint32_t> strides = sweep_strides();
+  std::vector<double> bandwidths;
+
+  std::cout << "partition stride sweep (" << chunk_count << " chunks of " << chunk_size << " B in flight, "
+            << buffer_size / 1024 / 1024 << " MiB buffer)\n--------------------\n";
+  for (std::uint32_t stride : strides) {
+    std::cout << stride << " B stride:";
+    for (std::uint32_t offset : offsets) {
+      double bandwidth = stride_bandwidth(context, pipeline, buffers, stride, offset);
+      if (offset == 0) {
+        bandwidths.push_back(bandwidth);
+      }
+      std::cout << " offset " << offset << " @ " << bandwidth << " MiB/sec;";
+    }
+    std::cout << '\n';
+  }
+
+  print_pipeline_statistics("kernel", pipeline.executables());
+
+  const double median = percentile(bandwidths, 0.5);
+  std::cout << "bad strides (below " << bad_stride_fraction * 100 << "% of median " << median << " MiB/sec):";
+  for (std::size_t i = 0; i < strides.size(); i++) {
+    if (bandwidths[i] < median * bad_stride_fraction) {
+      std::cout << ' ' << strides[i];
+    }
+  }
+  std::cout << '\n';
+}
+
+// Every stride and offset of the sweep as a point. The points share the
+// kernel, and each allocates the buffer again, so that only one holds memory
+// at a time. The bad strides are left to the full benchmark.
+std::vector<SuitePoint> partition_stride_points(Context &context) {
+  const std::uint32_t buffer_size = checked_buffer_size(context);
+  std::shared_ptr<ComputePipeline> pipeline(new ComputePipeline(
+      context.create_compute_pipeline(shaders::partition_stride, sizeof(PartitionStridePushConstants))));
+  std::vector<SuitePoint> points;
+  for (std::uint32_t stride : sweep_strides()) {
+    for (std::uint32_t offset : offsets) {
+      points.push_back({
+          .name = "partition-stride " + std::to_string(stride) + " B offset " + std::to_string(offset),
+          .bytes = stride_bytes(buffer_size, stride),
+          .prepare =
+              [&context, pipeline, buffer_size, stride, offset] {
+                auto buffers = std::make_shared<StrideBuffers>(context, buffer_size);
+                auto stride_case = std::make_shared<StrideCase>(context, *pipeline, *buffers, stride, offset);
+                return std::function<double()>([pipeline, buffers, stride_case] { return stride_case->run(); });
+              },
+      });
+    }
+  }
+  return points;
+}
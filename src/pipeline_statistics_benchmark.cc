@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "benchmark.hh"
+#include "shaders.hh"
+#include "vkcontext.hh"
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+
+#include <vulkan/vulkan_core.h>
+
+namespace {
+
+struct Kernel {
+  const char *name;
+  std::span<const std::uint32_t> code;
+  bool float16 = false;
+  // Printed before the statistics, for kernels compiled differently here
+  // than where they are measured
+  const char *note = nullptr;
+};
+
+// Every compute kernel in src/shaders
+const std::array kernels{
+    Kernel{"access_pattern", shaders::access_pattern},
+    Kernel{"bind_address", shaders::bind_address},
+    Kernel{"bind_descriptor", shaders::bind_descriptor, false,
+           "compiled with the default BUFFER_COUNT = 1, the binding benchmark prints the variants it runs"},
+    Kernel{"bind_push_address", shaders::bind_push_address},
+    Kernel{"copy", shaders::copy},
+    Kernel{"copy_descriptor", shaders::copy_descriptor},
+    Kernel{"copy_list", shaders::copy_list},
+    Kernel{"page_stride", shaders::page_stride},
+    Kernel{"partition_stride", shaders::partition_stride},
+    Kernel{"peak_fp16", shaders::peak_fp16, true},
+    Kernel{"peak_fp32", shaders::peak_fp32},
+    Kernel{"peak_int32", shaders::peak_int32},
+};
+
+// Covers the push constants of every kernel
+constexpr std::uint32_t push_constant_size = 128;
+
+} // namespace
+
+// Dumps the compiler statistics and internal representations of every
+// kernel. Kernels that use descriptors all bind two storage buffers.
+void pipeline_statistics_benchmark(Context &context) {
+  std::cout << "pipeline executables\n--------------------\n";
+  if (!context.pipeline_executable_info()) {
+    std::cout << "VK_KHR_pipeline_executable_properties is not supported\n";
+    return;
+  }
+
+  std::array<VkDescriptorSetLayoutBinding, 2> bindings{
+      VkDescriptorSetLayoutBinding{
+          .binding = 0,
+          .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .descriptorCount = 1,
+          .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+      },
+      VkDescriptorSetLayoutBinding{
+          .binding = 1,
+          .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .descriptorCount = 1,
+          .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+      },
+  };
+  VkDescriptorSetLayoutCreateInfo set_layout_ci{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .bindingCount = bindings.size(),
+      .pBindings = bindings.data(),
+  };
+  VkDescriptorSetLayout set_layout;
+  if (vkCreateDescriptorSetLayout(context.device(), &set_layout_ci, context.allocation_callbacks(), &set_layout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("unable to create descriptor set layout");
+  }
+
+  for (const Kernel &kernel : kernels) {
+    if (kernel.float16 && !context.shader_float16()) {
+      std::cout << kernel.name << ": skipped, shaderFloat16 is not supported\n";
+      continue;
+    }
+    if (kernel.note) {
+      std::cout << kernel.name << ": " << kernel.note << '\n';
+    }
+    ComputePipeline pipeline = context.create_compute_pipeline(kernel.code, push_constant_size, {&set_layout, 1});
+    for (const PipelineExecutable &executable : pipeline.executables()) {
+      std::cout << kernel.name << ": " << executable.name << " (subgroup " << executable.subgroup_size << ")\n";
+      for (const PipelineStatistic &statistic : executable.statistics) {
+        std::cout << "  " << statistic.name << " = " << statistic.value << '\n';
+      }
+      for (const PipelineInternalRepresentation &representation : executable.internal_representations) {
+        if (representation.text) {
+          std::cout << "  " << representation.name << ":\n" << representation.data << '\n';
+        } else {
+          std::cout << "  " << representation.name << ": " << representation.data.size() << " bytes (binary)\n";
+        }
+      }
+    }
+  }
+
+  vkDestroyDescriptorSetLayout(context.device(), set_layout, context.allocation_callbacks());
+}
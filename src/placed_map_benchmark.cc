@@ -0,0 +1,207 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "benchmark.hh"
+#include "vkcontext.hh"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <stdexcept>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vulkan/vulkan_core.h>
+
+namespace {
+
+constexpr VkDeviceSize buffer_size = 64 * 1024 * 1024;
+// The usual large page size, so that the kernel can map the range with huge
+// pages if the driver's backing allows it
+constexpr VkDeviceSize placed_alignment = 2 * 1024 * 1024;
+constexpr int pass_count = 4;
+
+struct MemoryKind {
+  const char *name;
+  std::uint32_t flags;
+};
+
+// Only the host touches the memory, so non-coherent memory needs no flushes
+constexpr std::array memory_kinds{
+    MemoryKind{"coherent", VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT},
+    MemoryKind{"cached", VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT},
+    MemoryKind{"coherent cached", VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                                      VK_MEMORY_PROPERTY_HOST_CACHED_BIT},
+    MemoryKind{"device-local coherent", VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT},
+    // Integrated GPUs and lavapipe
+    MemoryKind{"device-local coherent cached", VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                                                   VK_MEMORY_PROPERTY_HOST_CACHED_BIT},
+};
+
+// A PROT_NONE range of virtual addresses with an aligned start, which nothing
+// else can be mapped into until it is destroyed
+class AddressReservation {
+  void *m_mapping = nullptr;
+  std::size_t m_mapping_size = 0;
+  void *m_address = nullptr;
+
+public:
+  AddressReservation(std::size_t size, std::size_t alignment) : m_mapping_size(size + alignment) {
+    m_mapping = ::mmap(nullptr, m_mapping_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (m_mapping == MAP_FAILED) {
+      throw std::runtime_error("unable to reserve address range");
+    }
+    const std::uintptr_t start = reinterpret_cast<std::uintptr_t>(m_mapping);
+    m_address = reinterpret_cast<void *>((start + alignment - 1) / alignment * alignment);
+  }
+  AddressReservation(const AddressReservation &) = delete;
+  AddressReservation(AddressReservation &&) = delete;
+  ~AddressReservation() { ::munmap(m_mapping, m_mapping_size); }
+
+  void *address() const { return m_address; }
+};
+
+// Counts data TLB misses of this thread in user space, if perf events are
+// permitted (kernel.perf_event_paranoid of 2 or less)
+class TlbMissCounter {
+  int m_fd = -1;
+
+public:
+  explicit TlbMissCounter(std::uint64_t operation) {
+    perf_event_attr attributes{};
+    attributes.type = PERF_TYPE_HW_CACHE;
+    attributes.size = sizeof(attributes);
+    attributes.config = PERF_COUNT_HW_CACHE_DTLB | (operation << 8) |
+                        (static_cast<std::uint64_t>(PERF_COUNT_HW_CACHE_RESULT_MISS) << 16);
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    m_fd = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+  }
+  TlbMissCounter(const TlbMissCounter &) = delete;
+  TlbMissCounter(TlbMissCounter &&) = delete;
+  ~TlbMissCounter() {
+    if (m_fd >= 0) {
+      close(m_fd);
+    }
+  }
+
+  void start() const {
+    if (m_fd >= 0) {
+      ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  std::optional<std::uint64_t> stop() const {
+    std::uint64_t count;
+    if (m_fd < 0 || ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0) != 0 || read(m_fd, &count, sizeof(count)) != sizeof(count)) {
+      return std::nullopt;
+    }
+    return count;
+  }
+};
+
+long minor_faults() {
+  rusage usage;
+  getrusage(RUSAGE_THREAD, &usage);
+  return usage.ru_minflt;
+}
+
+void print_misses(const char *label, std::optional<std::uint64_t> misses) {
+  std::cout << ", " << label << " dTLB misses ";
+  if (misses) {
+    std::cout << static_cast<double>(*misses) / (pass_count * buffer_size / 1024 / 1024) << "/MiB";
+  } else {
+    std::cout << "n/a";
+  }
+}
+
+void placed_map_case_benchmark(const Context &context, const MemoryKind &kind, bool placed) {
+  // Outlives the buffer, whose destructor hands the range back to it
+  std::optional<AddressReservation> reservation;
+  Buffer buffer = context.create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+  buffer.allocate(kind.flags);
+
+  const VkDeviceSize alignment = std::max(placed_alignment, context.placed_map_alignment());
+  Clock::time_point start = Clock::now();
+  std::span<std::uint8_t> data;
+  if (placed) {
+    reservation.emplace(buffer.allocation_size(), alignment);
+    data = buffer.mmap_placed(reservation->address());
+  } else {
+    data = buffer.mmap();
+  }
+  const double map_seconds = elapsed_seconds(start);
+  std::span<std::uint64_t> words{reinterpret_cast<std::uint64_t *>(data.data()), data.size() / sizeof(std::uint64_t)};
+
+  // The first write faults the pages in
+  long faults = minor_faults();
+  start = Clock::now();
+  std::fill(words.begin(), words.end(), 1);
+  const double first_write_seconds = elapsed_seconds(start);
+  faults = minor_faults() - faults;
+
+  TlbMissCounter write_misses(PERF_COUNT_HW_CACHE_OP_WRITE);
+  write_misses.start();
+  start = Clock::now();
+  for (int pass = 0; pass < pass_count; pass++) {
+    std::fill(words.begin(), words.end(), pass);
+  }
+  const double write_seconds = elapsed_seconds(start);
+  std::optional<std::uint64_t> write_miss_count = write_misses.stop();
+
+  TlbMissCounter read_misses(PERF_COUNT_HW_CACHE_OP_READ);
+  read_misses.start();
+  start = Clock::now();
+  std::uint64_t sum = 0;
+  for (int pass = 0; pass < pass_count; pass++) {
+    sum += std::accumulate(words.begin(), words.end(), std::uint64_t{0});
+  }
+  const double read_seconds = elapsed_seconds(start);
+  std::optional<std::uint64_t> read_miss_count = read_misses.stop();
+  // Every word holds the last pass number
+  if (sum != pass_count * words.size() * (pass_count - 1)) {
+    throw std::runtime_error("mapped memory read back wrong values");
+  }
+
+  const bool aligned = reinterpret_cast<std::uintptr_t>(data.data()) % placed_alignment == 0;
+  std::cout << "  " << (placed ? "placed" : "default") << " at " << static_cast<const void *>(data.data())
+            << (aligned ? " (2 MiB aligned)" : "") << ": map " << map_seconds * 1e6 << " us, first write "
+            << mib_per_second(buffer_size, first_write_seconds) << " MiB/sec (" << faults << " faults), write "
+            << mib_per_second(pass_count * buffer_size, write_seconds) << " MiB/sec, read "
+            << mib_per_second(pass_count * buffer_size, read_seconds) << " MiB/sec";
+  print_misses("write", write_miss_count);
+  print_misses("read", read_miss_count);
+  std::cout << '\n';
+}
+
+} // namespace
+
+void placed_map_benchmark(Context &context) {
+  std::cout << "placed memory map (" << buffer_size / 1024 / 1024 << " MiB)\n--------------------\n";
+  if (!context.placed_memory_map()) {
+    std::cout << "skipped, VK_EXT_map_memory_placed with memoryMapPlaced and memoryUnmapReserve is not supported\n";
+    return;
+  }
+  std::cout << "minPlacedMemoryMapAlignment " << context.placed_map_alignment() << " B\n";
+
+  for (const MemoryKind &kind : memory_kinds) {
+    if (!context.has_memory_type(kind.flags)) {
+      std::cout << kind.name << ": skipped, no such memory type\n";
+      continue;
+    }
+    std::cout << kind.name << '\n';
+    placed_map_case_benchmark(context, kind, false);
+    placed_map_case_benchmark(context, kind, true);
+  }
+}
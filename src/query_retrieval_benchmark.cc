@@ -0,0 +1,280 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "benchmark.hh"
+#include "vkcontext.hh"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+namespace {
+
+enum class Retrieval {
+  // vkGetQueryPoolResults with VK_QUERY_RESULT_WAIT_BIT
+  wait,
+  // vkGetQueryPoolResults with VK_QUERY_RESULT_WITH_AVAILABILITY_BIT until
+  // both queries are available
+  poll,
+  // vkCmdCopyQueryPoolResults into host-visible memory, read after the fence
+  copy,
+};
+
+enum class Reset {
+  // vkCmdResetQueryPool at the end of the command buffer, for the queries
+  // that the next submission writes
+  command,
+  // vkResetQueryPool on the host before every submission (hostQueryReset)
+  host,
+};
+
+struct RetrievalCase {
+  const char *name;
+  Retrieval retrieval;
+  Reset reset;
+};
+
+constexpr std::array retrieval_cases{
+    RetrievalCase{"wait, command reset", Retrieval::wait, Reset::command},
+    RetrievalCase{"wait, host reset", Retrieval::wait, Reset::host},
+    RetrievalCase{"poll, command reset", Retrieval::poll, Reset::command},
+    RetrievalCase{"poll, host reset", Retrieval::poll, Reset::host},
+    RetrievalCase{"copy, command reset", Retrieval::copy, Reset::command},
+    RetrievalCase{"copy, host reset", Retrieval::copy, Reset::host},
+};
+
+// Small enough to stand in for the work between two timestamps of a frame
+constexpr VkDeviceSize work_size = 64 * 1024;
+
+constexpr int iteration_count = 256;
+
+// Submissions alternate between two ranges of two queries. A range is reset
+// by the submission before the one that writes it, so that its results are
+// unavailable until the GPU writes them again.
+constexpr std::uint32_t range_count = 2;
+constexpr std::uint32_t range_size = 2;
+
+// CPU time of the calling thread, which unlike wall time does not count
+// while the thread sleeps in the driver
+double thread_cpu_seconds() {
+  timespec time;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+struct Sample {
+  // From the return of the submission until the timestamps are in hand
+  double latency_seconds;
+  double cpu_seconds;
+  // Host reset only
+  double reset_cpu_seconds;
+  // Poll only
+  int poll_count;
+};
+
+// Writes the timestamps into the range starting at first_query and, with
+// command reset, resets the range starting at next_query
+void record(const CommandBuffer &command_buffer, const QueryPool &query_pool, std::uint32_t first_query,
+            std::uint32_t next_query, const Buffer &work, const RetrievalCase &retrieval_case, const Buffer *results) {
+  command_buffer.begin();
+  vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_NONE, query_pool.handle(), first_query);
+  vkCmdFillBuffer(command_buffer.handle(), work.handle(), 0, VK_WHOLE_SIZE, 0);
+  vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, query_pool.handle(),
+                       first_query + 1);
+  if (results) {
+    vkCmdCopyQueryPoolResults(command_buffer.handle(), query_pool.handle(), first_query, range_size, results->handle(),
+                              0, sizeof(std::uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    // Makes the copied results visible to the host once the fence signals
+    VkMemoryBarrier2 barrier{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT,
+        .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT,
+    };
+    VkDependencyInfo dependency_info{
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+    };
+    vkCmdPipelineBarrier2(command_buffer.handle(), &dependency_info);
+  }
+  if (retrieval_case.reset == Reset::command) {
+    vkCmdResetQueryPool(command_buffer.handle(), query_pool.handle(), next_query, range_size);
+  }
+  command_buffer.end();
+}
+
+// Resets every query on the device and waits for it, so that no submission
+// finds results left over from an earlier one
+void reset_queries(const Context &context, const QueryPool &query_pool, const Fence &fence) {
+  CommandBuffer command_buffer = context.create_command_buffer();
+  command_buffer.begin();
+  vkCmdResetQueryPool(command_buffer.handle(), query_pool.handle(), 0, range_count * range_size);
+  command_buffer.end();
+  command_buffer.submit(fence);
+  fence.wait();
+  fence.reset();
+}
+
+// Returns the timestamps, which the caller checks for sanity
+std::array<std::uint64_t, 2> retrieve(const Context &context, const QueryPool &query_pool, std::uint32_t first_query,
+                                      const Fence &fence, const RetrievalCase &retrieval_case,
+                                      std::span<const std::uint8_t> results, Sample &sample) {
+  std::array<std::uint64_t, 2> timestamps{};
+  switch (retrieval_case.retrieval) {
+  case Retrieval::wait:
+    if (vkGetQueryPoolResults(context.device(), query_pool.handle(), first_query, range_size, sizeof(timestamps),
+                              timestamps.data(), sizeof(std::uint64_t),
+                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS) {
+      throw std::runtime_error("unable to get query pool results");
+    }
+    break;
+  case Retrieval::poll: {
+    // Value and availability of each query
+    std::array<std::uint64_t, 4> values{};
+    do {
+      sample.poll_count++;
+      VkResult result = vkGetQueryPoolResults(context.device(), query_pool.handle(), first_query, range_size,
+                                              sizeof(values), values.data(), 2 * sizeof(std::uint64_t),
+                                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+      if (result != VK_SUCCESS && result != VK_NOT_READY) {
+        throw std::runtime_error("unable to get query pool results");
+      }
+    } while (values[1] == 0 || values[3] == 0);
+    timestamps = {values[0], values[2]};
+    break;
+  }
+  case Retrieval::copy:
+    fence.wait();
+    std::copy_n(reinterpret_cast<const std::uint64_t *>(results.data()), 2, timestamps.begin());
+    break;
+  }
+  return timestamps;
+}
+
+// last_start is the start timestamp that the range held before, which the
+// new one must differ from
+Sample measure(const Context &context, const CommandBuffer &command_buffer, const QueryPool &query_pool,
+               std::uint32_t first_query, const Fence &fence, const RetrievalCase &retrieval_case,
+               std::span<const std::uint8_t> results, std::uint64_t &last_start) {
+  Sample sample{};
+  if (retrieval_case.reset == Reset::host) {
+    const double reset_start = thread_cpu_seconds();
+    vkResetQueryPool(context.device(), query_pool.handle(), first_query, range_size);
+    sample.reset_cpu_seconds = thread_cpu_seconds() - reset_start;
+  }
+
+  command_buffer.submit(fence);
+  const Clock::time_point start = Clock::now();
+  const double cpu_start = thread_cpu_seconds();
+  std::array<std::uint64_t, 2> timestamps =
+      retrieve(context, query_pool, first_query, fence, retrieval_case, results, sample);
+  sample.cpu_seconds = thread_cpu_seconds() - cpu_start;
+  sample.latency_seconds = elapsed_seconds(start);
+
+  if (retrieval_case.retrieval != Retrieval::copy) {
+    fence.wait();
+  }
+  fence.reset();
+  if (timestamps[1] < timestamps[0]) {
+    throw std::runtime_error("timestamps out of order");
+  }
+  if (timestamps[0] == last_start) {
+    throw std::runtime_error("stale timestamps, the queries were not reset");
+  }
+  last_start = timestamps[0];
+  return sample;
+}
+
+// Submits and waits for the fence only, the latency that every strategy
+// starts from
+std::vector<double> baseline_latencies(const CommandBuffer &command_buffer, const Fence &fence) {
+  std::vector<double> latencies;
+  for (int count = 0; count < iteration_count; count++) {
+    command_buffer.submit(fence);
+    const Clock::time_point start = Clock::now();
+    fence.wait();
+    latencies.push_back(elapsed_seconds(start));
+    fence.reset();
+  }
+  return latencies;
+}
+
+} // namespace
+
+void query_retrieval_benchmark(Context &context) {
+  Buffer work = context.create_buffer(work_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  work.allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  Buffer results = context.create_buffer(2 * sizeof(std::uint64_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  results.allocate(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  std::span<const std::uint8_t> results_data = results.mmap();
+
+  QueryPool query_pool = context.create_timestamp_query_pool(range_count * range_size);
+  Fence fence = context.create_fence();
+
+  std::cout << "query retrieval (" << iteration_count << " submissions each)\n--------------------\n";
+
+  double baseline_latency;
+  {
+    // Writes and resets the same range, as the results are never read
+    CommandBuffer command_buffer = context.create_command_buffer();
+    record(command_buffer, query_pool, 0, 0, work, retrieval_cases[0], nullptr);
+    reset_queries(context, query_pool, fence);
+    const std::vector<double> latencies = baseline_latencies(command_buffer, fence);
+    baseline_latency = percentile(latencies, 0.5);
+    std::cout << "fence only: latency p50 " << baseline_latency * 1e6 << " us p99 " << percentile(latencies, 0.99) * 1e6
+              << " us\n";
+  }
+
+  for (const RetrievalCase &retrieval_case : retrieval_cases) {
+    const bool copy = retrieval_case.retrieval == Retrieval::copy;
+    // One command buffer per range
+    std::vector<std::unique_ptr<CommandBuffer>> command_buffers;
+    for (std::uint32_t range = 0; range < range_count; range++) {
+      command_buffers.emplace_back(new CommandBuffer(context.create_command_buffer()));
+      record(*command_buffers.back(), query_pool, range * range_size, (range + 1) % range_count * range_size, work,
+             retrieval_case, copy ? &results : nullptr);
+    }
+    // The first submission needs its queries reset, like any later one
+    reset_queries(context, query_pool, fence);
+    std::array<std::uint64_t, range_count> last_starts{};
+    auto measure_next = [&, submission = 0]() mutable {
+      const std::uint32_t range = submission++ % range_count;
+      return measure(context, *command_buffers[range], query_pool, range * range_size, fence, retrieval_case,
+                     results_data, last_starts[range]);
+    };
+
+    std::vector<double> latencies;
+    double cpu_seconds = 0;
+    double reset_cpu_seconds = 0;
+    std::uint64_t poll_count = 0;
+    // The first submission warms up the path and is not counted
+    measure_next();
+    for (int count = 0; count < iteration_count; count++) {
+      Sample sample = measure_next();
+      latencies.push_back(sample.latency_seconds);
+      cpu_seconds += sample.cpu_seconds;
+      reset_cpu_seconds += sample.reset_cpu_seconds;
+      poll_count += sample.poll_count;
+    }
+
+    const double latency = percentile(latencies, 0.5);
+    std::cout << retrieval_case.name << ": latency p50 " << latency * 1e6 << " us (+"
+              << (latency - baseline_latency) * 1e6 << " us over fence) p99 " << percentile(latencies, 0.99) * 1e6
+              << " us, CPU " << cpu_seconds / iteration_count * 1e6 << " us";
+    if (retrieval_case.reset == Reset::host) {
+      std::cout << " + reset " << reset_cpu_seconds / iteration_count * 1e6 << " us";
+    }
+    if (retrieval_case.retrieval == Retrieval::poll) {
+      std::cout << ", " << static_cast<double>(poll_count) / iteration_count << " polls";
+    }
+    std::cout << '\n';
+  }
+}
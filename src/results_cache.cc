@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "results_cache.hh"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <system_error>
+#include <utility>
+
+#include <sys/utsname.h>
+#include <vulkan/vulkan_core.h>
+
+#ifndef VKMEMBENCH_VERSION
+#define VKMEMBENCH_VERSION "unknown"
+#endif
+
+namespace {
+
+// Separates the key from the output in a cache file
+constexpr std::string_view key_end = "--\n";
+
+// FNV-1a, 64 bit
+std::uint64_t hash(std::string_view data) {
+  std::uint64_t hash = 0xcbf29ce484222325;
+  for (char c : data) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+} // namespace
+
+std::string environment_key(const Context &context) {
+  VkPhysicalDeviceIDProperties id_properties{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES,
+  };
+  VkPhysicalDeviceProperties2 properties{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+      .pNext = &id_properties,
+  };
+  vkGetPhysicalDeviceProperties2(context.physical_device(), &properties);
+
+  std::ostringstream key;
+  key << "device=" << properties.properties.deviceName << "\ndevice_uuid=" << std::hex << std::setfill('0');
+  for (std::uint8_t byte : id_properties.deviceUUID) {
+    key << std::setw(2) << static_cast<unsigned>(byte);
+  }
+  key << std::dec << "\ndriver_version=" << properties.properties.driverVersion << '\n';
+  // Heaps change size with settings such as resizable BAR
+  for (std::uint32_t i = 0; i < context.memory_properties().memoryHeapCount; i++) {
+    key << "heap" << i << '=' << context.memory_properties().memoryHeaps[i].size << '\n';
+  }
+  key << "validation=" << context.validation_enabled()
+      << "\nrobustness=" << static_cast<int>(context.robustness()) << '\n';
+
+  utsname name;
+  if (uname(&name) == 0) {
+    key << "kernel=" << name.release << ' ' << name.version << '\n';
+  }
+  key << "version=" << VKMEMBENCH_VERSION << '\n';
+  return key.str();
+}
+
+ResultsCache::ResultsCache(std::filesystem::path directory, std::chrono::seconds max_age)
+    : m_directory(std::move(directory)), m_max_age(max_age) {}
+
+std::filesystem::path ResultsCache::default_directory() {
+  if (const char *cache_home = std::getenv("XDG_CACHE_HOME"); cache_home && *cache_home) {
+    return std::filesystem::path(cache_home) / "vkmembench";
+  }
+  if (const char *home = std::getenv("HOME"); home && *home) {
+    return std::filesystem::path(home) / ".cache" / "vkmembench";
+  }
+  return {};
+}
+
+std::optional<std::string> ResultsCache::load(std::string_view key, std::chrono::seconds &age) const {
+  const std::filesystem::path file_path = path(key);
+  std::error_code error;
+  const std::filesystem::file_time_type written = std::filesystem::last_write_time(file_path, error);
+  if (error) {
+    return std::nullopt;
+  }
+  age = std::chrono::duration_cast<std::chrono::seconds>(std::filesystem::file_time_type::clock::now() - written);
+  if (age > m_max_age) {
+    return std::nullopt;
+  }
+
+  std::ifstream file(file_path, std::ios::binary);
+  if (!file) {
+    return std::nullopt;
+  }
+  std::string contents(std::istreambuf_iterator<char>(file), {});
+  if (!contents.starts_with(key) || contents.substr(key.size(), key_end.size()) != key_end) {
+    return std::nullopt;
+  }
+  return contents.substr(key.size() + key_end.size());
+}
+
+void ResultsCache::store(std::string_view key, std::string_view output) const {
+  // Written aside and renamed, so an interrupted run leaves no partial entry
+  const std::filesystem::path file_path = path(key);
+  std::filesystem::path temporary_path = file_path;
+  temporary_path += ".tmp";
+  std::error_code error;
+  std::filesystem::create_directories(m_directory, error);
+  if (!error) {
+    std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+    file << key << key_end << output;
+    if (!file.flush()) {
+      error = std::make_error_code(std::errc::io_error);
+    }
+  }
+  if (!error) {
+    std::filesystem::rename(temporary_path, file_path, error);
+  }
+  if (error) {
+    std::filesystem::remove(temporary_path, error);
+    std::cerr << "warning: unable to cache results in " << m_directory.string() << '\n';
+  }
+}
+
+std::filesystem::path ResultsCache::path(std::string_view key) const {
+  char name[17];
+  std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash(key)));
+  return m_directory / name;
+}
+
+OutputCapture::OutputCapture(std::ostream &stream)
+    : m_stream(stream), m_original(stream.rdbuf()), m_tee(m_original, m_copy.rdbuf()) {
+  m_stream.rdbuf(&m_tee);
+}
+
+OutputCapture::~OutputCapture() {
+  m_stream.rdbuf(m_original);
+}
+
+OutputCapture::Tee::int_type OutputCapture::Tee::overflow(int_type c) {
+  if (traits_type::eq_int_type(c, traits_type::eof())) {
+    return traits_type::not_eof(c);
+  }
+  const char ch = traits_type::to_char_type(c);
+  if (m_first->sputc(ch) == traits_type::eof() || m_second->sputc(ch) == traits_type::eof()) {
+    return traits_type::eof();
+  }
+  return c;
+}
+
+std::streamsize OutputCapture::Tee::xsputn(const char *s, std::streamsize n) {
+  m_second->sputn(s, n);
+  return m_first->sputn(s, n);
+}
+
+int OutputCapture::Tee::sync() {
+  return m_first->pubsync() | m_second->pubsync();
+}
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#pragma once
+
+#include "vkcontext.hh"
+
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+
+// Device UUID, driver version, heap sizes, validation, robustness, kernel
+// version and tool version, one "name=value" line each. Benchmark parameters
+// are appended by the caller.
+std::string environment_key(const Context &context);
+
+// Printed output of earlier benchmark runs, one file per key. Files are named
+// by a hash of the key and hold the full key, so a collision reads as a miss.
+class ResultsCache {
+public:
+  ResultsCache(std::filesystem::path directory, std::chrono::seconds max_age);
+
+  // $XDG_CACHE_HOME/vkmembench, or ~/.cache/vkmembench. Empty if neither
+  // variable is set.
+  static std::filesystem::path default_directory();
+
+  // Output stored under key, if it was stored less than max_age ago. age is
+  // set to how long ago that was.
+  std::optional<std::string> load(std::string_view key, std::chrono::seconds &age) const;
+  // Warns on std::cerr if the cache directory or file cannot be written, as
+  // the results have been printed already
+  void store(std::string_view key, std::string_view output) const;
+
+private:
+  std::filesystem::path path(std::string_view key) const;
+
+  std::filesystem::path m_directory;
+  std::chrono::seconds m_max_age;
+};
+
+// Copies everything written to a stream into a string while it still reaches
+// the stream, until destroyed
+class OutputCapture {
+public:
+  explicit OutputCapture(std::ostream &stream);
+  OutputCapture(const OutputCapture &) = delete;
+  OutputCapture(OutputCapture &&) = delete;
+  ~OutputCapture();
+
+  OutputCapture &operator=(const OutputCapture &) = delete;
+  OutputCapture &operator=(OutputCapture &&) = delete;
+
+  std::string output() const { return m_copy.str(); }
+
+private:
+  class Tee : public std::streambuf {
+  public:
+    Tee(std::streambuf *first, std::streambuf *second) : m_first(first), m_second(second) {}
+
+  protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char *s, std::streamsize n) override;
+    int sync() override;
+
+  private:
+    std::streambuf *m_first;
+    std::streambuf *m_second;
+  };
+
+  std::ostream &m_stream;
+  std::streambuf *m_original;
+  std::ostringstream m_copy;
+  Tee m_tee;
+};
@@ -0,0 +1,249 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "benchmark.hh"
+#include "shaders.hh"
+#include "vkcontext.hh"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+namespace {
+
+// Largest buffer, if maxStorageBufferRange covers it
+constexpr std::uint64_t max_buffer_size = 256ull * 1024 * 1024;
+constexpr std::uint32_t group_count = 4096;
+constexpr int iteration_count = 8;
+
+// Matches the constants in src/shaders/access_pattern.comp
+enum class AccessPattern : std::uint32_t {
+  sequential = 0,
+  strided = 1,
+  random = 2,
+};
+
+struct AccessPatternPushConstants {
+  std::uint32_t count;
+  AccessPattern pattern;
+  std::uint32_t stride;
+};
+
+struct KernelCase {
+  const char *name;
+  bool copy;
+  AccessPattern pattern;
+};
+
+constexpr std::array kernel_cases{
+    KernelCase{"copy", true, AccessPattern::sequential},
+    KernelCase{"sequential read", false, AccessPattern::sequential},
+    KernelCase{"strided read", false, AccessPattern::strided},
+    KernelCase{"random read", false, AccessPattern::random},
+};
+
+const char *robustness_name(Robustness robustness) {
+  switch (robustness) {
+  case Robustness::none:
+    return "none";
+  case Robustness::robust_buffer_access:
+    return "robustBufferAccess";
+  case Robustness::robust_buffer_access_2:
+    return "robustBufferAccess2";
+  }
+  return "unknown";
+}
+
+bool robust_buffer_access_2_supported(const Context &context) {
+  if (!context.has_extension(VK_EXT_ROBUSTNESS_2_EXTENSION_NAME)) {
+    return false;
+  }
+  VkPhysicalDeviceRobustness2FeaturesEXT robustness_2_features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ROBUSTNESS_2_FEATURES_EXT,
+  };
+  VkPhysicalDeviceFeatures2 features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+      .pNext = &robustness_2_features,
+  };
+  vkGetPhysicalDeviceFeatures2(context.physical_device(), &features);
+  return robustness_2_features.robustBufferAccess2;
+}
+
+// The descriptors bind whole buffers, which must be within
+// maxStorageBufferRange. The spec only guarantees 128 MiB. A power of two
+// keeps the element count a multiple of the stride.
+std::uint64_t buffer_size_within_range(const Context &context) {
+  VkPhysicalDeviceProperties physical_properties;
+  vkGetPhysicalDeviceProperties(context.physical_device(), &physical_properties);
+  return std::bit_floor(std::min<std::uint64_t>(max_buffer_size, physical_properties.limits.maxStorageBufferRange));
+}
+
+struct KernelResults {
+  // MiB/sec of each kernel case, in order
+  std::vector<double> bandwidths;
+  std::vector<PipelineExecutable> copy_executables;
+  std::vector<PipelineExecutable> access_executables;
+};
+
+// The kernels bind their buffers through descriptors, as robustness does not
+// apply to accesses through buffer device addresses.
+KernelResults kernel_results(const Context &context, std::uint64_t buffer_size) {
+  std::array<VkDescriptorSetLayoutBinding, 2> bindings{
+      VkDescriptorSetLayoutBinding{
+          .binding = 0,
+          .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .descriptorCount = 1,
+          .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+      },
+      VkDescriptorSetLayoutBinding{
+          .binding = 1,
+          .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .descriptorCount = 1,
+          .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+      },
+  };
+  VkDescriptorSetLayoutCreateInfo set_layout_ci{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .bindingCount = bindings.size(),
+      .pBindings = bindings.data(),
+  };
+  VkDescriptorSetLayout set_layout;
+  if (vkCreateDescriptorSetLayout(context.device(), &set_layout_ci, context.allocation_callbacks(), &set_layout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("unable to create descriptor set layout");
+  }
+
+  VkDescriptorPoolSize pool_size{
+      .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .descriptorCount = bindings.size(),
+  };
+  VkDescriptorPoolCreateInfo pool_ci{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .maxSets = 1,
+      .poolSizeCount = 1,
+      .pPoolSizes = &pool_size,
+  };
+  VkDescriptorPool pool;
+  if (vkCreateDescriptorPool(context.device(), &pool_ci, context.allocation_callbacks(), &pool) != VK_SUCCESS) {
+    throw std::runtime_error("unable to create descriptor pool");
+  }
+  VkDescriptorSetAllocateInfo set_ai{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .descriptorPool = pool,
+      .descriptorSetCount = 1,
+      .pSetLayouts = &set_layout,
+  };
+  VkDescriptorSet set;
+  if (vkAllocateDescriptorSets(context.device(), &set_ai, &set) != VK_SUCCESS) {
+    throw std::runtime_error("unable to allocate descriptor set");
+  }
+
+  Buffer src = context.create_buffer(buffer_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  src.allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  Buffer dst = context.create_buffer(buffer_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  dst.allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  std::array<VkDescriptorBufferInfo, 2> buffer_infos{
+      VkDescriptorBufferInfo{.buffer = src.handle(), .offset = 0, .range = VK_WHOLE_SIZE},
+      VkDescriptorBufferInfo{.buffer = dst.handle(), .offset = 0, .range = VK_WHOLE_SIZE},
+  };
+  VkWriteDescriptorSet write{
+      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+      .dstSet = set,
+      .dstBinding = 0,
+      .descriptorCount = buffer_infos.size(),
+      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .pBufferInfo = buffer_infos.data(),
+  };
+  vkUpdateDescriptorSets(context.device(), 1, &write, 0, nullptr);
+
+  ComputePipeline copy_pipeline =
+      context.create_compute_pipeline(shaders::copy_descriptor, sizeof(std::uint32_t), {&set_layout, 1});
+  ComputePipeline access_pipeline =
+      context.create_compute_pipeline(shaders::access_pattern, sizeof(AccessPatternPushConstants), {&set_layout, 1});
+
+  QueryPool query_pool = context.create_timestamp_query_pool(2);
+  Fence fence = context.create_fence();
+
+  KernelResults results{
+      .copy_executables = copy_pipeline.executables(),
+      .access_executables = access_pipeline.executables(),
+  };
+  for (const KernelCase &kernel_case : kernel_cases) {
+    const ComputePipeline &pipeline = kernel_case.copy ? copy_pipeline : access_pipeline;
+
+    CommandBuffer command_buffer = context.create_command_buffer();
+    command_buffer.begin();
+    vkCmdResetQueryPool(command_buffer.handle(), query_pool.handle(), 0, 2);
+    vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_NONE, query_pool.handle(), 0);
+    vkCmdBindPipeline(command_buffer.handle(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.handle());
+    vkCmdBindDescriptorSets(command_buffer.handle(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.layout(), 0, 1, &set, 0,
+                            nullptr);
+    if (kernel_case.copy) {
+      std::uint32_t count = buffer_size / 16;
+      vkCmdPushConstants(command_buffer.handle(), pipeline.layout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(count),
+                         &count);
+    } else {
+      AccessPatternPushConstants push_constants{
+          .count = static_cast<std::uint32_t>(buffer_size / sizeof(std::uint32_t)),
+          .pattern = kernel_case.pattern,
+          .stride = 64,
+      };
+      vkCmdPushConstants(command_buffer.handle(), pipeline.layout(), VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                         sizeof(push_constants), &push_constants);
+    }
+    vkCmdDispatch(command_buffer.handle(), group_count, 1, 1);
+    vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, query_pool.handle(), 1);
+    command_buffer.end();
+
+    double total_seconds = 0;
+    for (int count = 0; count < iteration_count; count++) {
+      total_seconds += timed_submit(context, command_buffer, fence, query_pool);
+    }
+    results.bandwidths.push_back(mib_per_second(buffer_size * iteration_count, total_seconds));
+  }
+
+  vkDestroyDescriptorPool(context.device(), pool, context.allocation_callbacks());
+  vkDestroyDescriptorSetLayout(context.device(), set_layout, context.allocation_callbacks());
+  return results;
+}
+
+} // namespace
+
+void robustness_benchmark(Context &context) {
+  std::vector<Robustness> robustness_modes{Robustness::none, Robustness::robust_buffer_access};
+  if (robust_buffer_access_2_supported(context)) {
+    robustness_modes.push_back(Robustness::robust_buffer_access_2);
+  }
+
+  const std::uint64_t buffer_size = buffer_size_within_range(context);
+  std::cout << "robust buffer access (" << buffer_size / 1024 / 1024 << " MiB)\n--------------------\n";
+  std::vector<double> baseline;
+  for (Robustness robustness : robustness_modes) {
+    // Robustness is fixed at device creation, so each mode gets its own device
+    Context robust_context(context.validation_enabled(), robustness, context.allocation_callbacks());
+    KernelResults results = kernel_results(robust_context, buffer_size);
+    context.add_footprint(robust_context.footprint());
+    const std::vector<double> &bandwidths = results.bandwidths;
+    if (robustness == Robustness::none) {
+      baseline = bandwidths;
+    }
+
+    std::cout << robustness_name(robustness) << '\n';
+    for (std::size_t i = 0; i < kernel_cases.size(); i++) {
+      std::cout << "  " << kernel_cases[i].name << " @ " << bandwidths[i] << " MiB/sec";
+      if (robustness != Robustness::none) {
+        std::cout << " (" << (bandwidths[i] / baseline[i] - 1) * 100 << "%)";
+      }
+      std::cout << '\n';
+    }
+    // Robustness shows up as extra bounds checks in the compiled kernels
+    print_pipeline_statistics("copy", results.copy_executables);
+    print_pipeline_statistics("access", results.access_executables);
+  }
+}
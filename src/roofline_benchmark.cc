@@ -0,0 +1,241 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "benchmark.hh"
+#include "chart.hh"
+#include "shaders.hh"
+#include "vkcontext.hh"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+namespace {
+
+constexpr const char *chart_name = "roofline.svg";
+
+constexpr std::uint32_t group_size = 256;
+constexpr int iteration_count = 4;
+
+// Eight chains of four-wide multiply-adds, each counted as two operations
+constexpr std::uint64_t operations_per_iteration = 8 * 4 * 2;
+constexpr std::uint32_t peak_group_count = 4096;
+constexpr std::uint32_t peak_iterations = 4096;
+
+// Matches the push constants of src/shaders/peak_*.comp
+struct PeakPushConstants {
+  VkDeviceAddress result;
+  std::uint32_t iterations;
+  // float or uint, as the kernel expects
+  std::uint32_t multiplier;
+  std::uint32_t addend;
+};
+
+struct PeakKernel {
+  const char *name;
+  std::span<const std::uint32_t> code;
+  bool integer;
+  bool float16;
+};
+
+const std::array peak_kernels{
+    PeakKernel{"fp32", shaders::peak_fp32, false, false},
+    PeakKernel{"fp16", shaders::peak_fp16, false, true},
+    PeakKernel{"int32", shaders::peak_int32, true, false},
+};
+
+// Working sets that are read over and over. The small ones stay in the
+// caches, the streaming ones are as large as the heap budget allows, up to
+// working_set, so that they stream from memory.
+struct MemoryLevel {
+  const char *name;
+  std::uint32_t working_set;
+  std::uint32_t flags;
+  bool streaming = false;
+};
+
+constexpr std::array memory_levels{
+    MemoryLevel{"16 KiB", 16 * 1024, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT},
+    MemoryLevel{"256 KiB", 256 * 1024, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT},
+    MemoryLevel{"4 MiB", 4 * 1024 * 1024, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT},
+    MemoryLevel{"64 MiB", 64 * 1024 * 1024, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT},
+    MemoryLevel{"VRAM", 1024 * 1024 * 1024, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true},
+    MemoryLevel{"host-visible", 256 * 1024 * 1024,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true},
+};
+
+// Streaming levels smaller than this would mostly hit the caches
+constexpr std::uint32_t min_streaming_working_set = 64 * 1024 * 1024;
+
+constexpr std::uint32_t bandwidth_group_count = 1024;
+constexpr std::uint32_t bandwidth_pass_count = 64;
+
+// Arithmetic intensity range of the chart, in operations per byte
+constexpr double min_intensity = 1.0 / 16;
+constexpr double max_intensity = 1024;
+
+// Average GPU seconds of one dispatch
+template <typename PushConstants>
+double time_dispatch(const Context &context, const ComputePipeline &pipeline, const PushConstants &push_constants,
+                     std::uint32_t group_count) {
+  QueryPool query_pool = context.create_timestamp_query_pool(2);
+  Fence fence = context.create_fence();
+  CommandBuffer command_buffer = context.create_command_buffer();
+  command_buffer.begin();
+  vkCmdResetQueryPool(command_buffer.handle(), query_pool.handle(), 0, 2);
+  vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_NONE, query_pool.handle(), 0);
+  vkCmdBindPipeline(command_buffer.handle(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.handle());
+  vkCmdPushConstants(command_buffer.handle(), pipeline.layout(), VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                     sizeof(push_constants), &push_constants);
+  vkCmdDispatch(command_buffer.handle(), group_count, 1, 1);
+  vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, query_pool.handle(), 1);
+  command_buffer.end();
+
+  // The first submission warms up clocks and caches
+  timed_submit(context, command_buffer, fence, query_pool);
+  double total_seconds = 0;
+  for (int count = 0; count < iteration_count; count++) {
+    total_seconds += timed_submit(context, command_buffer, fence, query_pool);
+  }
+  return total_seconds / iteration_count;
+}
+
+// Operations per second, and the compiler statistics of the kernel
+double peak_throughput(const Context &context, const PeakKernel &kernel, const Buffer &result,
+                       std::vector<PipelineExecutable> &executables) {
+  ComputePipeline pipeline = context.create_compute_pipeline(kernel.code, sizeof(PeakPushConstants));
+  PeakPushConstants push_constants{
+      .result = result.device_address(),
+      .iterations = peak_iterations,
+      .multiplier = kernel.integer ? 3u : std::bit_cast<std::uint32_t>(0.999f),
+      .addend = kernel.integer ? 1u : std::bit_cast<std::uint32_t>(0.001f),
+  };
+  const double seconds = time_dispatch(context, pipeline, push_constants, peak_group_count);
+  executables = pipeline.executables();
+  const std::uint64_t operations =
+      static_cast<std::uint64_t>(peak_group_count) * group_size * peak_iterations * operations_per_iteration;
+  return operations / seconds;
+}
+
+// Bytes per second
+double level_bandwidth(const Context &context, const ComputePipeline &pipeline, const MemoryLevel &level,
+                       std::uint32_t working_set, const Buffer &result) {
+  const VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+  Buffer src = context.create_buffer(working_set, usage);
+  src.allocate(level.flags);
+
+  // Sequential chunks that wrap around the working set
+  const std::uint32_t chunk_count = bandwidth_group_count * group_size / (partition_stride_chunk_size / 16);
+  PartitionStridePushConstants push_constants{
+      .src = src.device_address(),
+      .dst = result.device_address(),
+      .size_mask = working_set - 1,
+      .lap_chunk_count = working_set / partition_stride_chunk_size,
+      .stride = partition_stride_chunk_size,
+      .offset = 0,
+      .pass_count = bandwidth_pass_count,
+  };
+  const double seconds = time_dispatch(context, pipeline, push_constants, bandwidth_group_count);
+  return static_cast<double>(chunk_count) * partition_stride_chunk_size * bandwidth_pass_count / seconds;
+}
+
+// The working set of the level that fits the budget of its heap, as a power
+// of two, or 0 if it does not fit
+std::uint32_t fitting_working_set(const Context &context, const MemoryLevel &level) {
+  const VkDeviceSize budget = context.heap_budget(context.heap_index(level.flags).value());
+  if (!level.streaming) {
+    return level.working_set <= budget ? level.working_set : 0;
+  }
+  const auto working_set =
+      static_cast<std::uint32_t>(std::bit_floor(std::min<VkDeviceSize>(budget, level.working_set)));
+  return working_set >= min_streaming_working_set ? working_set : 0;
+}
+
+// Bandwidth-bound below the ridge point, compute-bound above it
+ChartSeries roof(const std::string &label, double bandwidth, double peak) {
+  ChartSeries series{label, {}};
+  series.points.push_back({min_intensity, std::min(peak, bandwidth * min_intensity) / 1e9});
+  const double ridge = peak / bandwidth;
+  if (ridge > min_intensity && ridge < max_intensity) {
+    series.points.push_back({ridge, peak / 1e9});
+  }
+  series.points.push_back({max_intensity, std::min(peak, bandwidth * max_intensity) / 1e9});
+  return series;
+}
+
+} // namespace
+
+void roofline_benchmark(Context &context) {
+  const VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+  Buffer result = context.create_buffer(16, usage);
+  result.allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  std::cout << "roofline\n--------------------\n";
+
+  std::vector<const PeakKernel *> measured_kernels;
+  std::vector<double> peaks;
+  for (const PeakKernel &kernel : peak_kernels) {
+    if (kernel.float16 && !context.shader_float16()) {
+      std::cout << "peak " << kernel.name << ": skipped, shaderFloat16 is not supported\n";
+      continue;
+    }
+    measured_kernels.push_back(&kernel);
+    std::vector<PipelineExecutable> executables;
+    peaks.push_back(peak_throughput(context, kernel, result, executables));
+    std::cout << "peak " << kernel.name << " @ " << peaks.back() / 1e9 << " GOP/sec\n";
+    print_pipeline_statistics(kernel.name, executables);
+  }
+
+  ComputePipeline read_pipeline =
+      context.create_compute_pipeline(shaders::partition_stride, sizeof(PartitionStridePushConstants));
+  std::vector<std::string> measured_levels;
+  std::vector<double> bandwidths;
+  for (const MemoryLevel &level : memory_levels) {
+    if (!context.has_memory_type(level.flags)) {
+      std::cout << "bandwidth " << level.name << ": skipped, no such memory type\n";
+      continue;
+    }
+    const std::uint32_t working_set = fitting_working_set(context, level);
+    if (working_set == 0) {
+      std::cout << "bandwidth " << level.name << ": skipped, it does not fit in the heap budget\n";
+      continue;
+    }
+    measured_levels.push_back(level.streaming ? std::string(level.name) + " (" +
+                                                    std::to_string(working_set / 1024 / 1024) + " MiB)"
+                                              : std::string(level.name));
+    bandwidths.push_back(level_bandwidth(context, read_pipeline, level, working_set, result));
+    std::cout << "bandwidth " << measured_levels.back() << " @ " << bandwidths.back() / 1e9 << " GB/sec\n";
+  }
+
+  print_pipeline_statistics("read", read_pipeline.executables());
+
+  // Ridge points: kernels with a lower intensity are bound by that level
+  for (std::size_t i = 0; i < measured_levels.size(); i++) {
+    std::cout << "ridge " << measured_levels[i] << ':';
+    for (std::size_t j = 0; j < measured_kernels.size(); j++) {
+      std::cout << ' ' << measured_kernels[j]->name << ' ' << peaks[j] / bandwidths[i] << " op/B;";
+    }
+    std::cout << '\n';
+  }
+
+  LogLogChart chart{
+      .title = "Roofline",
+      .x_label = "arithmetic intensity (operations/byte)",
+      .y_label = "GOP/sec",
+  };
+  const double top_peak = *std::max_element(peaks.begin(), peaks.end());
+  for (std::size_t j = 0; j < measured_kernels.size(); j++) {
+    chart.series.push_back({std::string("peak ") + measured_kernels[j]->name,
+                            {{min_intensity, peaks[j] / 1e9}, {max_intensity, peaks[j] / 1e9}}});
+  }
+  for (std::size_t i = 0; i < measured_levels.size(); i++) {
+    chart.series.push_back(roof(measured_levels[i], bandwidths[i], top_peak));
+  }
+  write_chart(chart_name, chart);
+}
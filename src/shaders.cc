@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "shaders.hh"
+
+#include <cstdint>
+#include <span>
+
+namespace {
+
+constexpr std::uint32_t access_pattern_spv[] = {
+#include "access_pattern.comp.inc"
+};
+
+constexpr std::uint32_t bind_address_spv[] = {
+#include "bind_address.comp.inc"
+};
+
+constexpr std::uint32_t bind_descriptor_spv[] = {
+#include "bind_descriptor.comp.inc"
+};
+
+constexpr std::uint32_t bind_push_address_spv[] = {
+#include "bind_push_address.comp.inc"
+};
+
+constexpr std::uint32_t copy_spv[] = {
+#include "copy.comp.inc"
+};
+
+constexpr std::uint32_t copy_descriptor_spv[] = {
+#include "copy_descriptor.comp.inc"
+};
+
+constexpr std::uint32_t copy_list_spv[] = {
+#include "copy_list.comp.inc"
+};
+
+constexpr std::uint32_t page_stride_spv[] = {
+#include "page_stride.comp.inc"
+};
+
+constexpr std::uint32_t partition_stride_spv[] = {
+#include "partition_stride.comp.inc"
+};
+
+constexpr std::uint32_t peak_fp16_spv[] = {
+#include "peak_fp16.comp.inc"
+};
+
+constexpr std::uint32_t peak_fp32_spv[] = {
+#include "peak_fp32.comp.inc"
+};
+
+constexpr std::uint32_t peak_int32_spv[] = {
+#include "peak_int32.comp.inc"
+};
+
+} // namespace
+
+namespace shaders {
+
+const std::span<const std::uint32_t> access_pattern = access_pattern_spv;
+const std::span<const std::uint32_t> bind_address = bind_address_spv;
+const std::span<const std::uint32_t> bind_descriptor = bind_descriptor_spv;
+const std::span<const std::uint32_t> bind_push_address = bind_push_address_spv;
+const std::span<const std::uint32_t> copy = copy_spv;
+const std::span<const std::uint32_t> copy_descriptor = copy_descriptor_spv;
+const std::span<const std::uint32_t> copy_list = copy_list_spv;
+const std::span<const std::uint32_t> page_stride = page_stride_spv;
+const std::span<const std::uint32_t> partition_stride = partition_stride_spv;
+const std::span<const std::uint32_t> peak_fp16 = peak_fp16_spv;
+const std::span<const std::uint32_t> peak_fp32 = peak_fp32_spv;
+const std::span<const std::uint32_t> peak_int32 = peak_int32_spv;
+
+} // namespace shaders
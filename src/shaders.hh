@@ -0,0 +1,23 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+// SPIR-V for the compute kernels in src/shaders, compiled at build time.
+namespace shaders {
+
+extern const std::span<const std::uint32_t> access_pattern;
+extern const std::span<const std::uint32_t> bind_address;
+extern const std::span<const std::uint32_t> bind_descriptor;
+extern const std::span<const std::uint32_t> bind_push_address;
+extern const std::span<const std::uint32_t> copy;
+extern const std::span<const std::uint32_t> copy_descriptor;
+extern const std::span<const std::uint32_t> copy_list;
+extern const std::span<const std::uint32_t> page_stride;
+extern const std::span<const std::uint32_t> partition_stride;
+extern const std::span<const std::uint32_t> peak_fp16;
+extern const std::span<const std::uint32_t> peak_fp32;
+extern const std::span<const std::uint32_t> peak_int32;
+
+} // namespace shaders
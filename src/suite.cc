@@ -0,0 +1,220 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "suite.hh"
+#include "benchmark.hh"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <span>
+#include <vector>
+
+namespace {
+
+// Enough for a first estimate of the variance
+constexpr int pilot_sample_count = 3;
+
+// Points that happened to measure the same value in the pilot round still get
+// a share of the budget
+constexpr double min_variation = 1e-3;
+
+struct PointState {
+  // Welford's running mean and sum of squared deviations
+  int count = 0;
+  double mean = 0;
+  double m2 = 0;
+
+  double setup_seconds = 0;
+  double sample_seconds = 0;
+  // Samples allocated after the pilot round
+  std::int64_t allocated = 0;
+
+  void add(double value) {
+    count++;
+    const double delta = value - mean;
+    mean += delta / count;
+    m2 += delta * (value - mean);
+  }
+
+  double variance() const { return count > 1 ? m2 / (count - 1) : 0; }
+  double cost_per_sample() const { return sample_seconds / count; }
+};
+
+// Sets up the point, discards a warm-up sample and takes up to sample_count
+// samples, stopping early once the deadline has passed
+void measure(const SuitePoint &point, PointState &state, std::int64_t sample_count, Clock::time_point start,
+             double deadline) {
+  const Clock::time_point setup_start = Clock::now();
+  std::function<double()> sample = point.prepare();
+  // The first use of fresh resources pays for page faults and clock ramp-up
+  sample();
+  state.setup_seconds += elapsed_seconds(setup_start);
+
+  for (std::int64_t i = 0; i < sample_count; i++) {
+    const Clock::time_point sample_start = Clock::now();
+    state.add(sample());
+    state.sample_seconds += elapsed_seconds(sample_start);
+    if (elapsed_seconds(start) >= deadline) {
+      break;
+    }
+  }
+}
+
+// Neyman allocation of the remaining budget. Points whose share is less than
+// one sample are not revisited, which frees their setup cost for the others.
+// Points that the pilot round did not reach get nothing.
+void allocate(std::vector<PointState> &states, double remaining_seconds) {
+  std::vector<double> weights;
+  std::vector<bool> revisit;
+  for (const PointState &state : states) {
+    revisit.push_back(state.count > 0);
+    if (state.count == 0) {
+      weights.push_back(0);
+      continue;
+    }
+    const double variation = std::max(std::sqrt(state.variance()) / state.mean, min_variation);
+    weights.push_back(variation / std::sqrt(state.cost_per_sample()));
+  }
+
+  for (bool changed = true; changed;) {
+    double available = remaining_seconds;
+    double weighted_cost = 0;
+    for (std::size_t i = 0; i < states.size(); i++) {
+      if (revisit[i]) {
+        available -= states[i].setup_seconds;
+        weighted_cost += weights[i] * states[i].cost_per_sample();
+      }
+    }
+
+    changed = false;
+    for (std::size_t i = 0; i < states.size(); i++) {
+      states[i].allocated = 0;
+      if (!revisit[i]) {
+        continue;
+      }
+      if (available > 0) {
+        states[i].allocated = static_cast<std::int64_t>(available * weights[i] / weighted_cost);
+      }
+      if (states[i].allocated < 1) {
+        revisit[i] = false;
+        changed = true;
+      }
+    }
+  }
+}
+
+std::vector<std::size_t> shuffled_order(std::size_t size, std::mt19937_64 &random) {
+  std::vector<std::size_t> order(size);
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), random);
+  return order;
+}
+
+// 97.5th percentile of Student's t distribution with the given degrees of
+// freedom, for two-sided 95% confidence intervals
+double t_quantile_975(int degrees_of_freedom) {
+  constexpr std::array table{12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                             2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                             2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  if (degrees_of_freedom <= static_cast<int>(table.size())) {
+    return table[degrees_of_freedom - 1];
+  }
+  // Cornish-Fisher expansion around the normal quantile, within 0.001 above
+  // 30 degrees of freedom
+  constexpr double z = 1.959964;
+  const double n = degrees_of_freedom;
+  return z + (z * z * z + z) / (4 * n) + (5 * z * z * z * z * z + 16 * z * z * z + 3 * z) / (96 * n * n);
+}
+
+std::vector<SuiteResult> suite_results(std::span<const PointState> states) {
+  std::vector<SuiteResult> results;
+  for (const PointState &state : states) {
+    results.push_back({
+        .sample_count = state.count,
+        .mean_seconds = state.mean,
+        .relative_error = state.count > 0 ? std::sqrt(state.variance() / state.count) / state.mean : 0,
+        .cost_seconds = state.setup_seconds + state.sample_seconds,
+    });
+  }
+  return results;
+}
+
+} // namespace
+
+std::vector<SuiteResult> run_suite(std::span<const SuitePoint> points, double budget_seconds, std::uint64_t seed) {
+  const Clock::time_point start = Clock::now();
+  std::mt19937_64 random(seed);
+  std::vector<PointState> states(points.size());
+
+  for (std::size_t i : shuffled_order(points.size(), random)) {
+    if (elapsed_seconds(start) >= budget_seconds) {
+      break;
+    }
+    measure(points[i], states[i], pilot_sample_count, start, budget_seconds);
+  }
+
+  allocate(states, std::max(0.0, budget_seconds - elapsed_seconds(start)));
+  for (std::size_t i : shuffled_order(points.size(), random)) {
+    if (states[i].allocated > 0 && elapsed_seconds(start) < budget_seconds) {
+      measure(points[i], states[i], states[i].allocated, start, budget_seconds);
+    }
+  }
+  return suite_results(states);
+}
+
+PairedResult compare_paired(const SuitePoint &a, const SuitePoint &b, int pair_count, std::uint64_t seed) {
+  std::mt19937_64 random(seed);
+  std::bernoulli_distribution a_first;
+
+  std::function<double()> sample_a = a.prepare();
+  std::function<double()> sample_b = b.prepare();
+  // The first use of fresh resources pays for page faults and clock ramp-up
+  sample_a();
+  sample_b();
+
+  PointState a_state;
+  PointState b_state;
+  PointState ratios;
+  for (int pair = 0; pair < pair_count; pair++) {
+    double a_seconds;
+    double b_seconds;
+    if (a_first(random)) {
+      a_seconds = sample_a();
+      b_seconds = sample_b();
+    } else {
+      b_seconds = sample_b();
+      a_seconds = sample_a();
+    }
+    a_state.add(a_seconds);
+    b_state.add(b_seconds);
+    ratios.add(b_seconds / a_seconds - 1);
+  }
+
+  return {
+      .pair_count = pair_count,
+      .mean_a_seconds = a_state.mean,
+      .mean_b_seconds = b_state.mean,
+      .relative_difference = ratios.mean,
+      .confidence_half_width =
+          pair_count > 1 ? t_quantile_975(pair_count - 1) * std::sqrt(ratios.variance() / pair_count) : 0,
+  };
+}
+
+std::vector<SuiteResult> run_rounds(std::span<const SuitePoint> points, int round_count, int sample_count,
+                                    std::uint64_t seed) {
+  const Clock::time_point start = Clock::now();
+  std::mt19937_64 random(seed);
+  std::vector<PointState> states(points.size());
+
+  for (int round = 0; round < round_count; round++) {
+    for (std::size_t i : shuffled_order(points.size(), random)) {
+      measure(points[i], states[i], sample_count, start, std::numeric_limits<double>::infinity());
+    }
+  }
+  return suite_results(states);
+}
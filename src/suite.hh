@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <vector>
+
+// One measurement of a benchmark that the suite scheduler can sample as often
+// as its budget allows
+struct SuitePoint {
+  std::string name;
+  // Bytes moved by one sample, for reporting bandwidth. 0 if the point is not
+  // a bandwidth measurement.
+  std::uint64_t bytes = 0;
+  // Sets up the resources of the point and returns a function that takes one
+  // sample and returns its time in seconds. The resources are released with
+  // that function, so only one point holds memory at a time.
+  std::function<std::function<double()>()> prepare;
+};
+
+struct SuiteResult {
+  // 0 if the budget ran out before the point was reached
+  int sample_count;
+  double mean_seconds;
+  // Standard error of mean_seconds, relative to it
+  double relative_error;
+  // Host time spent on the point, setup included
+  double cost_seconds;
+};
+
+// Measures the points within budget_seconds of host time, which is only
+// exceeded by the setup or sample in progress when it runs out. A pilot round
+// takes a few samples of every point it reaches in the budget, then the rest
+// of the budget goes to the points in proportion to their coefficient of
+// variation over the square root of their cost per sample. That minimizes
+// the sum of the squared relative errors (Neyman allocation), so noisy points
+// get more samples and expensive stable ones fewer. Both passes visit the
+// points in an order shuffled by seed.
+std::vector<SuiteResult> run_suite(std::span<const SuitePoint> points, double budget_seconds, std::uint64_t seed);
+
+struct PairedResult {
+  int pair_count;
+  double mean_a_seconds;
+  double mean_b_seconds;
+  // Mean over the pairs of b / a - 1, negative if b is faster
+  double relative_difference;
+  // Half width of the 95% confidence interval of relative_difference
+  double confidence_half_width;
+};
+
+// Holds both points set up and takes pair_count pairs of samples, one of each
+// point back to back in an order chosen by seed, so that both see the same
+// clocks and temperature. Each pair gives one ratio, and the confidence
+// interval comes from the t distribution of the ratios.
+PairedResult compare_paired(const SuitePoint &a, const SuitePoint &b, int pair_count, std::uint64_t seed);
+
+// Takes sample_count samples of every point in each of round_count rounds,
+// visiting the points in a new random order every round, and merges the
+// samples of each point. Clock and thermal drift then spread over all points
+// instead of following the order of the sweep. The same seed gives the same
+// orders with the same standard library.
+std::vector<SuiteResult> run_rounds(std::span<const SuitePoint> points, int round_count, int sample_count,
+                                    std::uint64_t seed);
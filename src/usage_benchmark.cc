@@ -0,0 +1,321 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "benchmark.hh"
+#include "hostcopy.hh"
+#include "shaders.hh"
+#include "suite.hh"
+#include "vkcontext.hh"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <ios>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+namespace {
+
+struct UsageCase {
+  const char *name;
+  VkBufferUsageFlags usage;
+};
+
+// Transfer usage is added to every case so that the buffers can be copied.
+constexpr std::array usage_cases{
+    UsageCase{"transfer", 0},
+    UsageCase{"storage", VK_BUFFER_USAGE_STORAGE_BUFFER_BIT},
+    UsageCase{"uniform", VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT},
+    UsageCase{"vertex+index", VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT},
+    UsageCase{"device-address", VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT},
+    UsageCase{"storage+device-address", VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT},
+    UsageCase{"everything", VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT},
+};
+
+constexpr std::uint64_t case_buffer_size = 256ull * 1024 * 1024;
+constexpr int iteration_count = 16;
+
+VkBufferUsageFlags buffer_usage(const UsageCase &usage_case) {
+  return usage_case.usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+}
+
+bool has_device_address(const UsageCase &usage_case) {
+  return (usage_case.usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) != 0;
+}
+
+// The kernel reaches buffers through their device address, or else as
+// storage descriptors
+bool has_kernel(const UsageCase &usage_case) {
+  return has_device_address(usage_case) || (usage_case.usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) != 0;
+}
+
+// Bytes the kernel copies. A storage descriptor covers at most
+// maxStorageBufferRange.
+std::uint64_t kernel_copy_size(const Context &context, const UsageCase &usage_case) {
+  if (has_device_address(usage_case)) {
+    return case_buffer_size;
+  }
+  VkPhysicalDeviceProperties physical_properties;
+  vkGetPhysicalDeviceProperties(context.physical_device(), &physical_properties);
+  return std::min<std::uint64_t>(case_buffer_size, physical_properties.limits.maxStorageBufferRange & ~15u);
+}
+
+void print_requirements(const char *label, const Buffer &buffer) {
+  VkMemoryRequirements requirements = buffer.memory_requirements();
+  std::cout << "  " << label << ": size " << requirements.size << " alignment " << requirements.alignment
+            << " types 0x" << std::hex << requirements.memoryTypeBits << std::dec << '\n';
+}
+
+VkDescriptorSetLayout create_copy_set_layout(const Context &context) {
+  std::array<VkDescriptorSetLayoutBinding, 2> bindings{
+      VkDescriptorSetLayoutBinding{
+          .binding = 0,
+          .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .descriptorCount = 1,
+          .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+      },
+      VkDescriptorSetLayoutBinding{
+          .binding = 1,
+          .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .descriptorCount = 1,
+          .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+      },
+  };
+  VkDescriptorSetLayoutCreateInfo set_layout_ci{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .bindingCount = bindings.size(),
+      .pBindings = bindings.data(),
+  };
+  VkDescriptorSetLayout set_layout;
+  if (vkCreateDescriptorSetLayout(context.device(), &set_layout_ci, context.allocation_callbacks(), &set_layout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("unable to create descriptor set layout");
+  }
+  return set_layout;
+}
+
+// The copy kernels, shared by every usage case
+struct UsageKernels {
+  explicit UsageKernels(const Context &context)
+      : context(context), copy_pipeline(context.create_compute_pipeline(shaders::copy, sizeof(CopyPushConstants))),
+        set_layout(create_copy_set_layout(context)),
+        descriptor_pipeline(
+            context.create_compute_pipeline(shaders::copy_descriptor, sizeof(std::uint32_t), {&set_layout, 1})) {}
+  ~UsageKernels() { vkDestroyDescriptorSetLayout(context.device(), set_layout, context.allocation_callbacks()); }
+
+  const Context &context;
+  ComputePipeline copy_pipeline;
+  VkDescriptorSetLayout set_layout;
+  ComputePipeline descriptor_pipeline;
+};
+
+// A host-to-device copy between two buffers of one usage
+struct UsageCopyCase {
+  UsageCopyCase(const Context &context, const UsageCase &usage_case)
+      : context(context), src(context.create_buffer(case_buffer_size, buffer_usage(usage_case))),
+        dst(context.create_buffer(case_buffer_size, buffer_usage(usage_case))),
+        query_pool(context.create_timestamp_query_pool(2)), fence(context.create_fence()),
+        command_buffer(context.create_command_buffer()) {
+    src.allocate(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    std::span<std::uint8_t> data = src.mmap();
+    host_fill(src, data, 0xff);
+    dst.allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    VkBufferCopy copy{
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size = case_buffer_size,
+    };
+    command_buffer.begin();
+    vkCmdResetQueryPool(command_buffer.handle(), query_pool.handle(), 0, 2);
+    vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_NONE, query_pool.handle(), 0);
+    vkCmdCopyBuffer(command_buffer.handle(), src.handle(), dst.handle(), 1, &copy);
+    vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_COPY_BIT, query_pool.handle(), 1);
+    command_buffer.end();
+  }
+
+  // GPU seconds of one copy
+  double run() const { return timed_submit(context, command_buffer, fence, query_pool); }
+
+  const Context &context;
+  Buffer src;
+  Buffer dst;
+  QueryPool query_pool;
+  Fence fence;
+  CommandBuffer command_buffer;
+};
+
+// A device-to-device kernel copy between two buffers of one usage, which must
+// have a kernel
+struct UsageKernelCase {
+  UsageKernelCase(const Context &context, const UsageKernels &kernels, const UsageCase &usage_case)
+      : context(context), size(kernel_copy_size(context, usage_case)),
+        src(context.create_buffer(case_buffer_size, buffer_usage(usage_case))),
+        dst(context.create_buffer(case_buffer_size, buffer_usage(usage_case))),
+        query_pool(context.create_timestamp_query_pool(2)), fence(context.create_fence()),
+        command_buffer(context.create_command_buffer()) {
+    src.allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    dst.allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    command_buffer.begin();
+    vkCmdResetQueryPool(command_buffer.handle(), query_pool.handle(), 0, 2);
+    vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_NONE, query_pool.handle(), 0);
+    if (has_device_address(usage_case)) {
+      record_kernel_copy(command_buffer, kernels.copy_pipeline, src, dst, size);
+    } else {
+      record_descriptor_copy(kernels);
+    }
+    vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, query_pool.handle(), 1);
+    command_buffer.end();
+  }
+  ~UsageKernelCase() {
+    if (pool != VK_NULL_HANDLE) {
+      vkDestroyDescriptorPool(context.device(), pool, context.allocation_callbacks());
+    }
+  }
+
+  // GPU seconds of one copy
+  double run() const { return timed_submit(context, command_buffer, fence, query_pool); }
+
+  // Binds the first size bytes of both buffers to a set of their own pool
+  void record_descriptor_copy(const UsageKernels &kernels) {
+    VkDescriptorPoolSize pool_size{
+        .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 2,
+    };
+    VkDescriptorPoolCreateInfo pool_ci{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = 1,
+        .poolSizeCount = 1,
+        .pPoolSizes = &pool_size,
+    };
+    if (vkCreateDescriptorPool(context.device(), &pool_ci, context.allocation_callbacks(), &pool) != VK_SUCCESS) {
+      throw std::runtime_error("unable to create descriptor pool");
+    }
+    VkDescriptorSetAllocateInfo set_ai{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &kernels.set_layout,
+    };
+    VkDescriptorSet set;
+    if (vkAllocateDescriptorSets(context.device(), &set_ai, &set) != VK_SUCCESS) {
+      throw std::runtime_error("unable to allocate descriptor set");
+    }
+    std::array<VkDescriptorBufferInfo, 2> buffer_infos{
+        VkDescriptorBufferInfo{.buffer = src.handle(), .offset = 0, .range = size},
+        VkDescriptorBufferInfo{.buffer = dst.handle(), .offset = 0, .range = size},
+    };
+    VkWriteDescriptorSet write{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = set,
+        .dstBinding = 0,
+        .descriptorCount = buffer_infos.size(),
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo = buffer_infos.data(),
+    };
+    vkUpdateDescriptorSets(context.device(), 1, &write, 0, nullptr);
+
+    // As in record_kernel_copy, the kernel loops over the buffer
+    const ComputePipeline &pipeline = kernels.descriptor_pipeline;
+    std::uint32_t count = size / 16;
+    std::uint32_t group_count = std::clamp<std::uint32_t>((count + 255) / 256, 1, 65535);
+    vkCmdBindPipeline(command_buffer.handle(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.handle());
+    vkCmdBindDescriptorSets(command_buffer.handle(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.layout(), 0, 1, &set, 0,
+                            nullptr);
+    vkCmdPushConstants(command_buffer.handle(), pipeline.layout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(count),
+                       &count);
+    vkCmdDispatch(command_buffer.handle(), group_count, 1, 1);
+  }
+
+  const Context &context;
+  const std::uint64_t size;
+  Buffer src;
+  Buffer dst;
+  QueryPool query_pool;
+  Fence fence;
+  CommandBuffer command_buffer;
+  // Only for usages without a device address
+  VkDescriptorPool pool = VK_NULL_HANDLE;
+};
+
+void usage_case_benchmark(Context &context, const UsageKernels &kernels, const UsageCase &usage_case) {
+  std::cout << usage_case.name << '\n';
+  // Released before the kernel buffers are allocated
+  {
+    UsageCopyCase copy_case(context, usage_case);
+    print_requirements("host", copy_case.src);
+    print_requirements("device", copy_case.dst);
+
+    double total_seconds = 0;
+    for (int count = 0; count < iteration_count; count++) {
+      total_seconds += copy_case.run();
+    }
+    std::cout << "  copy @ " << mib_per_second(case_buffer_size * iteration_count, total_seconds) << " MiB/sec\n";
+  }
+
+  if (!has_kernel(usage_case)) {
+    std::cout << "  kernel: n/a (no storage usage)\n";
+    return;
+  }
+  UsageKernelCase kernel_case(context, kernels, usage_case);
+  double total_seconds = 0;
+  for (int count = 0; count < iteration_count; count++) {
+    total_seconds += kernel_case.run();
+  }
+  std::cout << "  kernel (" << (has_device_address(usage_case) ? "address" : "descriptor");
+  if (kernel_case.size != case_buffer_size) {
+    std::cout << ", " << kernel_case.size / (1024 * 1024) << " MiB";
+  }
+  std::cout << ") @ " << mib_per_second(kernel_case.size * iteration_count, total_seconds) << " MiB/sec\n";
+}
+
+} // namespace
+
+void usage_benchmark(Context &context) {
+  UsageKernels kernels(context);
+
+  std::cout << "buffer usage flags (" << case_buffer_size / 1024 / 1024 << " MiB)\n--------------------\n";
+  for (const UsageCase &usage_case : usage_cases) {
+    usage_case_benchmark(context, kernels, usage_case);
+  }
+  print_pipeline_statistics("address kernel", kernels.copy_pipeline.executables());
+  print_pipeline_statistics("descriptor kernel", kernels.descriptor_pipeline.executables());
+}
+
+// The copy and kernel of every usage case as separate points
+std::vector<SuitePoint> usage_points(Context &context) {
+  // Only the pipelines are shared, each point allocates its own buffers
+  auto kernels = std::make_shared<UsageKernels>(context);
+  std::vector<SuitePoint> points;
+  for (const UsageCase &usage_case : usage_cases) {
+    points.push_back({
+        .name = std::string("usage ") + usage_case.name + " copy",
+        .bytes = case_buffer_size,
+        .prepare =
+            [&context, &usage_case] {
+              auto copy_case = std::make_shared<UsageCopyCase>(context, usage_case);
+              return std::function<double()>([copy_case] { return copy_case->run(); });
+            },
+    });
+    if (has_kernel(usage_case)) {
+      points.push_back({
+          .name = std::string("usage ") + usage_case.name + " kernel",
+          .bytes = kernel_copy_size(context, usage_case),
+          .prepare =
+              [&context, kernels, &usage_case] {
+                auto kernel_case = std::make_shared<UsageKernelCase>(context, *kernels, usage_case);
+                return std::function<double()>([kernels, kernel_case] { return kernel_case->run(); });
+              },
+      });
+    }
+  }
+  return points;
+}
@@ -1,38 +1,153 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
 #include "vkcontext.hh"
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #include <vulkan/vulkan_core.h>
 
+namespace {
+
+// Device extensions that are enabled when available. Benchmarks that need
+// them check Context::has_extension.
+constexpr std::array optional_device_extensions{
+    VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME,
+    VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME,
+    VK_EXT_ROBUSTNESS_2_EXTENSION_NAME,
+    VK_KHR_PIPELINE_EXECUTABLE_PROPERTIES_EXTENSION_NAME,
+    VK_EXT_DEVICE_MEMORY_REPORT_EXTENSION_NAME,
+    VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+    VK_EXT_PCI_BUS_INFO_EXTENSION_NAME,
+    VK_KHR_MAP_MEMORY_2_EXTENSION_NAME,
+    VK_EXT_MAP_MEMORY_PLACED_EXTENSION_NAME,
+};
+
+// Inserts features into a pNext chain directly after head
+template <typename Head, typename Features>
+void chain(Head &head, Features &features) {
+  features.pNext = head.pNext;
+  head.pNext = &features;
+}
+
+} // namespace
+
+void MemoryReport::record(const VkDeviceMemoryReportCallbackDataEXT &data) {
+  std::lock_guard lock(m_mutex);
+  switch (data.type) {
+  case VK_DEVICE_MEMORY_REPORT_EVENT_TYPE_ALLOCATE_EXT:
+    if (data.objectType == VK_OBJECT_TYPE_DEVICE_MEMORY) {
+      m_totals.allocated_bytes += data.size;
+      m_totals.allocation_count++;
+    } else {
+      m_totals.internal_bytes[data.objectType] += data.size;
+      m_totals.internal_count++;
+    }
+    m_live_objects[data.memoryObjectId] = data.size;
+    m_totals.live_bytes += data.size;
+    break;
+  case VK_DEVICE_MEMORY_REPORT_EVENT_TYPE_IMPORT_EXT:
+    m_totals.imported_bytes += data.size;
+    m_totals.import_count++;
+    m_live_objects[data.memoryObjectId] = data.size;
+    m_totals.live_bytes += data.size;
+    break;
+  case VK_DEVICE_MEMORY_REPORT_EVENT_TYPE_FREE_EXT:
+  case VK_DEVICE_MEMORY_REPORT_EVENT_TYPE_UNIMPORT_EXT:
+    if (auto object = m_live_objects.find(data.memoryObjectId); object != m_live_objects.end()) {
+      m_totals.freed_bytes += object->second;
+      m_totals.live_bytes -= object->second;
+      m_live_objects.erase(object);
+    }
+    m_totals.free_count++;
+    break;
+  case VK_DEVICE_MEMORY_REPORT_EVENT_TYPE_ALLOCATION_FAILED_EXT:
+    m_totals.failed_count++;
+    break;
+  default:
+    break;
+  }
+  m_totals.peak_bytes = std::max(m_totals.peak_bytes, m_totals.live_bytes);
+}
+
+void MemoryReport::callback(const VkDeviceMemoryReportCallbackDataEXT *data, void *user_data) {
+  static_cast<MemoryReport *>(user_data)->record(*data);
+}
+
+void MemoryReport::reset() {
+  std::lock_guard lock(m_mutex);
+  const std::uint64_t live_bytes = m_totals.live_bytes;
+  m_totals = {};
+  m_totals.live_bytes = live_bytes;
+  m_totals.peak_bytes = live_bytes;
+}
+
+MemoryReportTotals MemoryReport::totals() const {
+  std::lock_guard lock(m_mutex);
+  return m_totals;
+}
+
+Memory::~Memory() {
+  vkFreeMemory(m_context.device(), m_handle, m_context.allocation_callbacks());
+  m_context.track_allocation(m_memory_type, m_size, false);
+}
+
 Buffer::~Buffer() {
   if (m_allocation) {
-    vkFreeMemory(m_context.device(), m_allocation.value(), nullptr);
+    // Hands a placed range back to the caller's reservation, which freeing
+    // would unmap
+    if (m_mapped && m_placed) {
+      munmap();
+    }
+    // Freeing the memory unmaps it too
+    if (m_mapped) {
+      m_context.track_mapping(m_size, false);
+    }
+    vkFreeMemory(m_context.device(), m_allocation.value(), m_context.allocation_callbacks());
+    m_context.track_allocation(m_memory_type, m_allocation_size, false);
   }
-  vkDestroyBuffer(m_context.device(), m_handle, nullptr);
+  vkDestroyBuffer(m_context.device(), m_handle, m_context.allocation_callbacks());
 }
 
 VkDeviceMemory Buffer::allocate(std::uint32_t memory_type_mask) {
-  std::optional<std::uint32_t> memory_type = m_context.find_memory_type(memory_type_mask);
+  VkMemoryRequirements requirements = memory_requirements();
+  std::optional<std::uint32_t> memory_type =
+      m_context.find_memory_type(memory_type_mask, requirements.memoryTypeBits);
   if (!memory_type) {
     throw std::runtime_error("unable to find memory type");
   }
 
+  // Buffers used through device addresses need the allocation to opt in too
+  VkMemoryAllocateFlagsInfo alloc_flags{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO,
+      .flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT,
+  };
   VkMemoryAllocateInfo alloc_ci{
       .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-      .allocationSize = m_size,
+      .pNext = (m_usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) ? &alloc_flags : nullptr,
+      .allocationSize = requirements.size,
       .memoryTypeIndex = memory_type.value(),
   };
   VkDeviceMemory buffer_memory;
-  if (vkAllocateMemory(m_context.device(), &alloc_ci, nullptr, &buffer_memory) != VK_SUCCESS) {
+  if (vkAllocateMemory(m_context.device(), &alloc_ci, m_context.allocation_callbacks(), &buffer_memory) != VK_SUCCESS) {
     throw std::runtime_error("unable to allocate buffer");
   }
   m_allocation.emplace(buffer_memory);
+  m_memory_type = memory_type.value();
+  m_allocation_size = requirements.size;
+  m_context.track_allocation(m_memory_type, m_allocation_size, true);
 
   if (vkBindBufferMemory(m_context.device(), m_handle, buffer_memory, 0) != VK_SUCCESS) {
     throw std::runtime_error("unable to bind buffer");
@@ -41,6 +156,13 @@ VkDeviceMemory Buffer::allocate(std::uint32_t memory_type_mask) {
   return buffer_memory;
 }
 
+void Buffer::bind(const Memory &memory, VkDeviceSize offset) {
+  assert(!m_allocation);
+  if (vkBindBufferMemory(m_context.device(), m_handle, memory.handle(), offset) != VK_SUCCESS) {
+    throw std::runtime_error("unable to bind buffer");
+  }
+}
+
 std::span<std::uint8_t> Buffer::mmap() {
   assert(m_allocation);
   assert(!m_mapped);
@@ -50,16 +172,71 @@ std::span<std::uint8_t> Buffer::mmap() {
     throw std::runtime_error("unable to map memory");
   }
   m_mapped = true;
+  m_context.track_mapping(m_size, true);
+  return {reinterpret_cast<std::uint8_t *>(ptr), m_size};
+}
+
+std::span<std::uint8_t> Buffer::mmap_placed(void *address) {
+  assert(m_allocation);
+  assert(!m_mapped);
+  assert(m_context.placed_memory_map());
+
+  // Without memoryMapRangePlaced only whole allocations can be placed
+  VkMemoryMapPlacedInfoEXT placed_info{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_MAP_PLACED_INFO_EXT,
+      .pPlacedAddress = address,
+  };
+  VkMemoryMapInfoKHR map_info{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_MAP_INFO_KHR,
+      .pNext = &placed_info,
+      .flags = VK_MEMORY_MAP_PLACED_BIT_EXT,
+      .memory = m_allocation.value(),
+      .offset = 0,
+      .size = VK_WHOLE_SIZE,
+  };
+  void *ptr;
+  if (m_context.m_map_memory2(m_context.device(), &map_info, &ptr) != VK_SUCCESS) {
+    throw std::runtime_error("unable to map memory at placed address");
+  }
+  m_mapped = true;
+  m_placed = true;
+  m_context.track_mapping(m_size, true);
   return {reinterpret_cast<std::uint8_t *>(ptr), m_size};
 }
 
 void Buffer::munmap() {
   assert(m_mapped);
   m_mapped = false;
-  vkUnmapMemory(m_context.device(), m_allocation.value());
+  if (m_placed) {
+    VkMemoryUnmapInfoKHR unmap_info{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_UNMAP_INFO_KHR,
+        .flags = VK_MEMORY_UNMAP_RESERVE_BIT_EXT,
+        .memory = m_allocation.value(),
+    };
+    m_placed = false;
+    m_context.m_unmap_memory2(m_context.device(), &unmap_info);
+  } else {
+    vkUnmapMemory(m_context.device(), m_allocation.value());
+  }
+  m_context.track_mapping(m_size, false);
+}
+
+VkMemoryRequirements Buffer::memory_requirements() const {
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(m_context.device(), m_handle, &requirements);
+  return requirements;
+}
+
+VkDeviceAddress Buffer::device_address() const {
+  assert(m_usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+  VkBufferDeviceAddressInfo address_info{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+      .buffer = m_handle,
+  };
+  return vkGetBufferDeviceAddress(m_context.device(), &address_info);
 }
 
-Fence::~Fence() { vkDestroyFence(m_context.device(), m_fence, nullptr); }
+Fence::~Fence() { vkDestroyFence(m_context.device(), m_fence, m_context.allocation_callbacks()); }
 
 void Fence::wait() const {
   // TODO: timeout parameter
@@ -74,24 +251,163 @@ void Fence::reset() const {
   }
 }
 
-Context::Context(bool validation_enabled) {
-  create_instance(validation_enabled);
+CommandBuffer::~CommandBuffer() {
+  vkFreeCommandBuffers(m_context.device(), m_context.compute_command_pool(), 1, &m_handle);
+}
+
+void CommandBuffer::begin() const {
+  VkCommandBufferBeginInfo begin_info{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+  };
+  if (vkBeginCommandBuffer(m_handle, &begin_info) != VK_SUCCESS) {
+    throw std::runtime_error("unable to begin command buffer");
+  }
+}
+
+void CommandBuffer::end() const {
+  if (vkEndCommandBuffer(m_handle) != VK_SUCCESS) {
+    throw std::runtime_error("unable to end command buffer");
+  }
+}
+
+void CommandBuffer::submit(const Fence &fence) const {
+  VkSubmitInfo submit_info{
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &m_handle,
+  };
+  if (vkQueueSubmit(m_context.compute_queue(), 1, &submit_info, fence.handle()) != VK_SUCCESS) {
+    throw std::runtime_error("unable to submit command buffer");
+  }
+}
+
+QueryPool::~QueryPool() { vkDestroyQueryPool(m_context.device(), m_handle, m_context.allocation_callbacks()); }
+
+std::vector<std::uint64_t> QueryPool::results() const {
+  std::vector<std::uint64_t> results(m_count);
+  if (vkGetQueryPoolResults(m_context.device(), m_handle, 0, m_count, results.size() * sizeof(std::uint64_t),
+                            results.data(), sizeof(std::uint64_t),
+                            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS) {
+    throw std::runtime_error("unable to get query pool results");
+  }
+  return results;
+}
+
+ComputePipeline::~ComputePipeline() {
+  vkDestroyPipeline(m_context.device(), m_handle, m_context.allocation_callbacks());
+  vkDestroyPipelineLayout(m_context.device(), m_layout, m_context.allocation_callbacks());
+  vkDestroyShaderModule(m_context.device(), m_shader_module, m_context.allocation_callbacks());
+}
+
+std::vector<PipelineExecutable> ComputePipeline::executables() const {
+  if (!m_context.pipeline_executable_info()) {
+    return {};
+  }
+
+  auto get_pipeline_executable_properties =
+      m_context.device_function<PFN_vkGetPipelineExecutablePropertiesKHR>("vkGetPipelineExecutablePropertiesKHR");
+  auto get_pipeline_executable_statistics =
+      m_context.device_function<PFN_vkGetPipelineExecutableStatisticsKHR>("vkGetPipelineExecutableStatisticsKHR");
+  auto get_pipeline_executable_internal_representations =
+      m_context.device_function<PFN_vkGetPipelineExecutableInternalRepresentationsKHR>(
+          "vkGetPipelineExecutableInternalRepresentationsKHR");
+
+  VkPipelineInfoKHR pipeline_info{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_INFO_KHR,
+      .pipeline = m_handle,
+  };
+  std::uint32_t executable_count = 0;
+  get_pipeline_executable_properties(m_context.device(), &pipeline_info, &executable_count, nullptr);
+  std::vector<VkPipelineExecutablePropertiesKHR> properties(
+      executable_count, {.sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_PROPERTIES_KHR});
+  get_pipeline_executable_properties(m_context.device(), &pipeline_info, &executable_count, properties.data());
+
+  std::vector<PipelineExecutable> executables;
+  for (std::uint32_t i = 0; i < executable_count; i++) {
+    PipelineExecutable &executable = executables.emplace_back();
+    executable.name = properties[i].name;
+    executable.subgroup_size = properties[i].subgroupSize;
+
+    VkPipelineExecutableInfoKHR executable_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_INFO_KHR,
+        .pipeline = m_handle,
+        .executableIndex = i,
+    };
+
+    std::uint32_t statistic_count = 0;
+    get_pipeline_executable_statistics(m_context.device(), &executable_info, &statistic_count, nullptr);
+    std::vector<VkPipelineExecutableStatisticKHR> statistics(
+        statistic_count, {.sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_STATISTIC_KHR});
+    get_pipeline_executable_statistics(m_context.device(), &executable_info, &statistic_count, statistics.data());
+    for (const VkPipelineExecutableStatisticKHR &statistic : statistics) {
+      std::string value;
+      switch (statistic.format) {
+      case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_BOOL32_KHR:
+        value = statistic.value.b32 ? "true" : "false";
+        break;
+      case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_INT64_KHR:
+        value = std::to_string(statistic.value.i64);
+        break;
+      case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_UINT64_KHR:
+        value = std::to_string(statistic.value.u64);
+        break;
+      case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_FLOAT64_KHR:
+        value = std::to_string(statistic.value.f64);
+        break;
+      default:
+        value = "?";
+        break;
+      }
+      executable.statistics.push_back({statistic.name, value});
+    }
+
+    // Sizes are queried first, then the data is fetched into our storage
+    std::uint32_t representation_count = 0;
+    get_pipeline_executable_internal_representations(m_context.device(), &executable_info, &representation_count,
+                                                     nullptr);
+    std::vector<VkPipelineExecutableInternalRepresentationKHR> representations(
+        representation_count, {.sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_INTERNAL_REPRESENTATION_KHR});
+    get_pipeline_executable_internal_representations(m_context.device(), &executable_info, &representation_count,
+                                                     representations.data());
+    std::vector<std::string> representation_data;
+    for (VkPipelineExecutableInternalRepresentationKHR &representation : representations) {
+      representation_data.emplace_back(representation.dataSize, '\0');
+      representation.pData = representation_data.back().data();
+    }
+    get_pipeline_executable_internal_representations(m_context.device(), &executable_info, &representation_count,
+                                                     representations.data());
+    for (std::uint32_t j = 0; j < representation_count; j++) {
+      std::string &data = representation_data[j];
+      // Text representations include their null terminator
+      if (representations[j].isText && !data.empty() && data.back() == '\0') {
+        data.pop_back();
+      }
+      executable.internal_representations.push_back(
+          {representations[j].name, static_cast<bool>(representations[j].isText), std::move(data)});
+    }
+  }
+  return executables;
+}
+
+Context::Context(bool validation_enabled, Robustness robustness, const VkAllocationCallbacks *allocation_callbacks)
+    : m_validation_enabled(validation_enabled), m_robustness(robustness), m_allocation_callbacks(allocation_callbacks) {
+  create_instance();
   create_device();
 }
 
 Context::~Context() {
   if (m_compute_command_pool) {
-    vkDestroyCommandPool(m_device, m_compute_command_pool, nullptr);
+    vkDestroyCommandPool(m_device, m_compute_command_pool, m_allocation_callbacks);
   }
   if (m_device) {
-    vkDestroyDevice(m_device, nullptr);
+    vkDestroyDevice(m_device, m_allocation_callbacks);
   }
   if (m_instance) {
-    vkDestroyInstance(m_instance, nullptr);
+    vkDestroyInstance(m_instance, m_allocation_callbacks);
   }
 }
 
-void Context::create_instance(bool validation_enabled) {
+void Context::create_instance() {
   // TODO: check if validation layers present
   VkApplicationInfo application_info{
       .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
@@ -102,10 +418,10 @@ void Context::create_instance(bool validation_enabled) {
       .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
       .pNext = nullptr,
       .pApplicationInfo = &application_info,
-      .enabledLayerCount = static_cast<std::uint32_t>(validation_enabled ? 1 : 0),
-      .ppEnabledLayerNames = validation_enabled ? &validation_layer_name : nullptr,
+      .enabledLayerCount = static_cast<std::uint32_t>(m_validation_enabled ? 1 : 0),
+      .ppEnabledLayerNames = m_validation_enabled ? &validation_layer_name : nullptr,
   };
-  if (vkCreateInstance(&instance_ci, nullptr, &m_instance)) {
+  if (vkCreateInstance(&instance_ci, m_allocation_callbacks, &m_instance)) {
     throw std::runtime_error("unable to create vulkan instance");
   }
 }
@@ -118,6 +434,8 @@ void Context::create_device() {
     throw std::runtime_error("unable to find physical device");
   }
 
+  vkGetPhysicalDeviceMemoryProperties(m_physical_device, &m_memory_properties);
+
   // Find compute queue
   std::uint32_t queue_family_count = 0;
   vkGetPhysicalDeviceQueueFamilyProperties(m_physical_device, &queue_family_count, nullptr);
@@ -142,9 +460,72 @@ void Context::create_device() {
     throw std::runtime_error("unable to find compute-capable queue");
   }
 
+  // Enable the optional extensions that are available
+  std::uint32_t extension_count = 0;
+  vkEnumerateDeviceExtensionProperties(m_physical_device, nullptr, &extension_count, nullptr);
+  std::vector<VkExtensionProperties> available_extensions(extension_count);
+  vkEnumerateDeviceExtensionProperties(m_physical_device, nullptr, &extension_count, available_extensions.data());
+  for (const char *extension : optional_device_extensions) {
+    for (const VkExtensionProperties &available_extension : available_extensions) {
+      if (std::strcmp(available_extension.extensionName, extension) == 0) {
+        m_enabled_extensions.push_back(extension);
+        break;
+      }
+    }
+  }
+
+  // Query optional features
+  VkPhysicalDeviceDescriptorBufferFeaturesEXT supported_descriptor_buffer_features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT,
+  };
+  VkPhysicalDeviceVulkan12Features supported_12_features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+  };
+  VkPhysicalDeviceFeatures2 supported_features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+      .pNext = &supported_12_features,
+  };
+  VkPhysicalDeviceRobustness2FeaturesEXT supported_robustness_2_features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ROBUSTNESS_2_FEATURES_EXT,
+  };
+  if (has_extension(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME)) {
+    chain(supported_features, supported_descriptor_buffer_features);
+  }
+  VkPhysicalDevicePipelineExecutablePropertiesFeaturesKHR supported_pipeline_executable_features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_EXECUTABLE_PROPERTIES_FEATURES_KHR,
+  };
+  if (has_extension(VK_EXT_ROBUSTNESS_2_EXTENSION_NAME)) {
+    chain(supported_features, supported_robustness_2_features);
+  }
+  if (has_extension(VK_KHR_PIPELINE_EXECUTABLE_PROPERTIES_EXTENSION_NAME)) {
+    chain(supported_features, supported_pipeline_executable_features);
+  }
+  VkPhysicalDeviceDeviceMemoryReportFeaturesEXT supported_memory_report_features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DEVICE_MEMORY_REPORT_FEATURES_EXT,
+  };
+  if (has_extension(VK_EXT_DEVICE_MEMORY_REPORT_EXTENSION_NAME)) {
+    chain(supported_features, supported_memory_report_features);
+  }
+  VkPhysicalDeviceMapMemoryPlacedFeaturesEXT supported_map_memory_placed_features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAP_MEMORY_PLACED_FEATURES_EXT,
+  };
+  if (has_extension(VK_EXT_MAP_MEMORY_PLACED_EXTENSION_NAME) && has_extension(VK_KHR_MAP_MEMORY_2_EXTENSION_NAME)) {
+    chain(supported_features, supported_map_memory_placed_features);
+  }
+  vkGetPhysicalDeviceFeatures2(m_physical_device, &supported_features);
+
+  if (m_robustness != Robustness::none && !supported_features.features.robustBufferAccess) {
+    throw std::runtime_error("robustBufferAccess is not supported");
+  }
+  if (m_robustness == Robustness::robust_buffer_access_2 && !supported_robustness_2_features.robustBufferAccess2) {
+    throw std::runtime_error("robustBufferAccess2 is not supported");
+  }
+
   // Create logical device
+  m_shader_float16 = supported_12_features.shaderFloat16;
   VkPhysicalDeviceVulkan12Features device_12_features{
       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+      .shaderFloat16 = m_shader_float16,
       .hostQueryReset = true,
       .bufferDeviceAddress = true,
   };
@@ -153,16 +534,90 @@ void Context::create_device() {
       .pNext = &device_12_features,
       .synchronization2 = true,
   };
+  VkPhysicalDeviceFeatures2 device_features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+      .pNext = &device_13_features,
+      .features =
+          {
+              .robustBufferAccess = m_robustness != Robustness::none,
+              .shaderStorageBufferArrayDynamicIndexing =
+                  supported_features.features.shaderStorageBufferArrayDynamicIndexing,
+          },
+  };
+  VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptor_buffer_features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT,
+      .descriptorBuffer = supported_descriptor_buffer_features.descriptorBuffer,
+  };
+  if (has_extension(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME)) {
+    chain(device_features, descriptor_buffer_features);
+  }
+  VkPhysicalDeviceRobustness2FeaturesEXT robustness_2_features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ROBUSTNESS_2_FEATURES_EXT,
+      .robustBufferAccess2 = m_robustness == Robustness::robust_buffer_access_2,
+  };
+  if (m_robustness == Robustness::robust_buffer_access_2) {
+    chain(device_features, robustness_2_features);
+  }
+  m_pipeline_executable_info = supported_pipeline_executable_features.pipelineExecutableInfo;
+  VkPhysicalDevicePipelineExecutablePropertiesFeaturesKHR pipeline_executable_features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_EXECUTABLE_PROPERTIES_FEATURES_KHR,
+      .pipelineExecutableInfo = true,
+  };
+  if (m_pipeline_executable_info) {
+    chain(device_features, pipeline_executable_features);
+  }
+  VkPhysicalDeviceDeviceMemoryReportFeaturesEXT memory_report_features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DEVICE_MEMORY_REPORT_FEATURES_EXT,
+      .deviceMemoryReport = true,
+  };
+  VkDeviceDeviceMemoryReportCreateInfoEXT memory_report_ci{
+      .sType = VK_STRUCTURE_TYPE_DEVICE_DEVICE_MEMORY_REPORT_CREATE_INFO_EXT,
+      .pfnUserCallback = MemoryReport::callback,
+  };
+  // The callback is registered with the device, so it sees the allocations
+  // made while creating it too
+  if (supported_memory_report_features.deviceMemoryReport) {
+    m_memory_report = std::make_unique<MemoryReport>();
+    memory_report_ci.pUserData = m_memory_report.get();
+    chain(device_features, memory_report_features);
+    chain(device_features, memory_report_ci);
+  }
+  m_placed_memory_map =
+      supported_map_memory_placed_features.memoryMapPlaced && supported_map_memory_placed_features.memoryUnmapReserve;
+  VkPhysicalDeviceMapMemoryPlacedFeaturesEXT map_memory_placed_features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAP_MEMORY_PLACED_FEATURES_EXT,
+      .memoryMapPlaced = true,
+      .memoryUnmapReserve = true,
+  };
+  if (m_placed_memory_map) {
+    chain(device_features, map_memory_placed_features);
+  }
   VkDeviceCreateInfo device_ci{
       .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-      .pNext = &device_13_features,
+      .pNext = &device_features,
       .queueCreateInfoCount = 1,
       .pQueueCreateInfos = &compute_queue_ci,
+      .enabledExtensionCount = static_cast<std::uint32_t>(m_enabled_extensions.size()),
+      .ppEnabledExtensionNames = m_enabled_extensions.data(),
   };
-  if (vkCreateDevice(m_physical_device, &device_ci, nullptr, &m_device) != VK_SUCCESS) {
+  if (vkCreateDevice(m_physical_device, &device_ci, m_allocation_callbacks, &m_device) != VK_SUCCESS) {
     throw std::runtime_error("unable to create device");
   }
 
+  if (m_placed_memory_map) {
+    VkPhysicalDeviceMapMemoryPlacedPropertiesEXT map_memory_placed_properties{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAP_MEMORY_PLACED_PROPERTIES_EXT,
+    };
+    VkPhysicalDeviceProperties2 properties{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &map_memory_placed_properties,
+    };
+    vkGetPhysicalDeviceProperties2(m_physical_device, &properties);
+    m_placed_map_alignment = map_memory_placed_properties.minPlacedMemoryMapAlignment;
+    m_map_memory2 = device_function<PFN_vkMapMemory2KHR>("vkMapMemory2KHR");
+    m_unmap_memory2 = device_function<PFN_vkUnmapMemory2KHR>("vkUnmapMemory2KHR");
+  }
+
   // TODO: check for error
   vkGetDeviceQueue(m_device, compute_queue_ci.queueFamilyIndex, 0, &m_compute_queue);
 
@@ -171,13 +626,71 @@ void Context::create_device() {
       .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
       .queueFamilyIndex = compute_queue_ci.queueFamilyIndex,
   };
-  vkCreateCommandPool(m_device, &command_pool_ci, nullptr, &m_compute_command_pool);
+  vkCreateCommandPool(m_device, &command_pool_ci, m_allocation_callbacks, &m_compute_command_pool);
+}
+
+void Context::track_allocation(std::uint32_t memory_type, VkDeviceSize size, bool allocated) const {
+  if ((m_memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) == 0) {
+    return;
+  }
+  if (allocated) {
+    m_footprint.device_local_bytes += size;
+    m_footprint.peak_device_local_bytes =
+        std::max(m_footprint.peak_device_local_bytes, m_footprint.device_local_bytes);
+  } else {
+    m_footprint.device_local_bytes -= size;
+  }
+}
+
+void Context::track_mapping(VkDeviceSize size, bool mapped) const {
+  if (mapped) {
+    m_footprint.mapped_bytes += size;
+    m_footprint.peak_mapped_bytes = std::max(m_footprint.peak_mapped_bytes, m_footprint.mapped_bytes);
+  } else {
+    m_footprint.mapped_bytes -= size;
+  }
+}
+
+void Context::reset_footprint() const {
+  m_footprint.peak_mapped_bytes = m_footprint.mapped_bytes;
+  m_footprint.peak_device_local_bytes = m_footprint.device_local_bytes;
+}
+
+void Context::add_footprint(const Footprint &other) const {
+  m_footprint.peak_mapped_bytes =
+      std::max(m_footprint.peak_mapped_bytes, m_footprint.mapped_bytes + other.peak_mapped_bytes);
+  m_footprint.peak_device_local_bytes =
+      std::max(m_footprint.peak_device_local_bytes, m_footprint.device_local_bytes + other.peak_device_local_bytes);
+}
+
+std::optional<VkDeviceSize> Context::device_local_heap_usage() const {
+  if (!has_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+    return {};
+  }
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+  };
+  VkPhysicalDeviceMemoryProperties2 properties{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+      .pNext = &budget,
+  };
+  vkGetPhysicalDeviceMemoryProperties2(m_physical_device, &properties);
+  VkDeviceSize usage = 0;
+  for (std::uint32_t i = 0; i < properties.memoryProperties.memoryHeapCount; i++) {
+    if (properties.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      usage += budget.heapUsage[i];
+    }
+  }
+  return usage;
 }
 
-std::optional<std::uint32_t> Context::find_memory_type(std::uint32_t flags) const {
+std::optional<std::uint32_t> Context::find_memory_type(std::uint32_t flags, std::uint32_t type_mask) const {
   VkPhysicalDeviceMemoryProperties properties;
   vkGetPhysicalDeviceMemoryProperties(m_physical_device, &properties);
   for (std::uint32_t i = 0; i < properties.memoryTypeCount; i++) {
+    if ((type_mask & (1u << i)) == 0) {
+      continue;
+    }
     // if ((properties.memoryTypes[i].propertyFlags & flags) == flags) {
     if (properties.memoryTypes[i].propertyFlags == flags) {
       return i;
@@ -186,7 +699,66 @@ std::optional<std::uint32_t> Context::find_memory_type(std::uint32_t flags) cons
   return {};
 }
 
-Buffer Context::create_buffer(std::uint32_t size, std::uint32_t usage) const {
+std::optional<std::uint32_t> Context::memory_flags_with(std::uint32_t required) const {
+  std::optional<std::uint32_t> best;
+  for (std::uint32_t i = 0; i < m_memory_properties.memoryTypeCount; i++) {
+    const std::uint32_t flags = m_memory_properties.memoryTypes[i].propertyFlags;
+    if ((flags & required) == required && (!best || std::popcount(flags) < std::popcount(*best))) {
+      best = flags;
+    }
+  }
+  return best;
+}
+
+VkDeviceSize Context::heap_size(std::uint32_t flags, std::uint32_t type_mask) const {
+  std::optional<std::uint32_t> memory_type = find_memory_type(flags, type_mask);
+  if (!memory_type) {
+    return 0;
+  }
+  return m_memory_properties.memoryHeaps[m_memory_properties.memoryTypes[memory_type.value()].heapIndex].size;
+}
+
+std::optional<std::uint32_t> Context::heap_index(std::uint32_t flags, std::uint32_t type_mask) const {
+  std::optional<std::uint32_t> memory_type = find_memory_type(flags, type_mask);
+  if (!memory_type) {
+    return {};
+  }
+  return m_memory_properties.memoryTypes[memory_type.value()].heapIndex;
+}
+
+VkDeviceSize Context::heap_budget(std::uint32_t heap_index) const {
+  if (!has_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+    return m_memory_properties.memoryHeaps[heap_index].size / 4 * 3;
+  }
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+  };
+  VkPhysicalDeviceMemoryProperties2 properties{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+      .pNext = &budget,
+  };
+  vkGetPhysicalDeviceMemoryProperties2(m_physical_device, &properties);
+  const VkDeviceSize budget_bytes = budget.heapBudget[heap_index];
+  const VkDeviceSize usage = budget.heapUsage[heap_index];
+  return budget_bytes > usage ? budget_bytes - usage : 0;
+}
+
+bool Context::has_extension(std::string_view name) const {
+  for (const char *extension : m_enabled_extensions) {
+    if (extension == name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+float Context::timestamp_period() const {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(m_physical_device, &properties);
+  return properties.limits.timestampPeriod;
+}
+
+Buffer Context::create_buffer(VkDeviceSize size, std::uint32_t usage) const {
   VkBufferCreateInfo buffer_ci{
       .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
       .size = size,
@@ -194,10 +766,53 @@ Buffer Context::create_buffer(std::uint32_t size, std::uint32_t usage) const {
       .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
   };
   VkBuffer buffer;
-  if (vkCreateBuffer(m_device, &buffer_ci, nullptr, &buffer) != VK_SUCCESS) {
+  if (vkCreateBuffer(m_device, &buffer_ci, m_allocation_callbacks, &buffer) != VK_SUCCESS) {
     throw std::runtime_error("unable to allocate buffer");
   }
-  return {*this, buffer, size};
+  return {*this, buffer, size, usage};
+}
+
+VkMemoryRequirements Context::buffer_memory_requirements(VkDeviceSize size, std::uint32_t usage) const {
+  VkBufferCreateInfo buffer_ci{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = size,
+      .usage = usage,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+  };
+  VkDeviceBufferMemoryRequirements requirements_info{
+      .sType = VK_STRUCTURE_TYPE_DEVICE_BUFFER_MEMORY_REQUIREMENTS,
+      .pCreateInfo = &buffer_ci,
+  };
+  VkMemoryRequirements2 requirements{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+  };
+  vkGetDeviceBufferMemoryRequirements(m_device, &requirements_info, &requirements);
+  return requirements.memoryRequirements;
+}
+
+Memory Context::allocate_memory(VkDeviceSize size, std::uint32_t flags, std::uint32_t type_mask,
+                                VkMemoryAllocateFlags allocate_flags) const {
+  std::optional<std::uint32_t> memory_type = find_memory_type(flags, type_mask);
+  if (!memory_type) {
+    throw std::runtime_error("unable to find memory type");
+  }
+
+  VkMemoryAllocateFlagsInfo alloc_flags{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO,
+      .flags = allocate_flags,
+  };
+  VkMemoryAllocateInfo alloc_ci{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+      .pNext = allocate_flags != 0 ? &alloc_flags : nullptr,
+      .allocationSize = size,
+      .memoryTypeIndex = memory_type.value(),
+  };
+  VkDeviceMemory memory;
+  if (vkAllocateMemory(m_device, &alloc_ci, m_allocation_callbacks, &memory) != VK_SUCCESS) {
+    throw std::runtime_error("unable to allocate memory");
+  }
+  track_allocation(memory_type.value(), size, true);
+  return {*this, memory, size, memory_type.value()};
 }
 
 Fence Context::create_fence() const {
@@ -206,6 +821,90 @@ Fence Context::create_fence() const {
   };
   VkFence fence;
   // TODO: check for error
-  vkCreateFence(m_device, &fence_ci, nullptr, &fence);
+  vkCreateFence(m_device, &fence_ci, m_allocation_callbacks, &fence);
   return {*this, fence};
 }
+
+CommandBuffer Context::create_command_buffer() const {
+  VkCommandBufferAllocateInfo command_buffer_ai{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool = m_compute_command_pool,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1,
+  };
+  VkCommandBuffer command_buffer;
+  if (vkAllocateCommandBuffers(m_device, &command_buffer_ai, &command_buffer) != VK_SUCCESS) {
+    throw std::runtime_error("unable to allocate command buffer");
+  }
+  return {*this, command_buffer};
+}
+
+QueryPool Context::create_timestamp_query_pool(std::uint32_t count) const {
+  VkQueryPoolCreateInfo query_pool_ci{
+      .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+      .queryType = VK_QUERY_TYPE_TIMESTAMP,
+      .queryCount = count,
+  };
+  VkQueryPool query_pool;
+  if (vkCreateQueryPool(m_device, &query_pool_ci, m_allocation_callbacks, &query_pool) != VK_SUCCESS) {
+    throw std::runtime_error("unable to create query pool");
+  }
+  return {*this, query_pool, count};
+}
+
+ComputePipeline Context::create_compute_pipeline(std::span<const std::uint32_t> code, std::uint32_t push_constant_size,
+                                                 std::span<const VkDescriptorSetLayout> set_layouts,
+                                                 const VkSpecializationInfo *specialization,
+                                                 VkPipelineCreateFlags flags) const {
+  VkShaderModuleCreateInfo shader_module_ci{
+      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      .codeSize = code.size_bytes(),
+      .pCode = code.data(),
+  };
+  VkShaderModule shader_module;
+  if (vkCreateShaderModule(m_device, &shader_module_ci, m_allocation_callbacks, &shader_module) != VK_SUCCESS) {
+    throw std::runtime_error("unable to create shader module");
+  }
+
+  VkPushConstantRange push_constant_range{
+      .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+      .offset = 0,
+      .size = push_constant_size,
+  };
+  VkPipelineLayoutCreateInfo layout_ci{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .setLayoutCount = static_cast<std::uint32_t>(set_layouts.size()),
+      .pSetLayouts = set_layouts.data(),
+      .pushConstantRangeCount = static_cast<std::uint32_t>(push_constant_size != 0 ? 1 : 0),
+      .pPushConstantRanges = push_constant_size != 0 ? &push_constant_range : nullptr,
+  };
+  VkPipelineLayout layout;
+  if (vkCreatePipelineLayout(m_device, &layout_ci, m_allocation_callbacks, &layout) != VK_SUCCESS) {
+    vkDestroyShaderModule(m_device, shader_module, m_allocation_callbacks);
+    throw std::runtime_error("unable to create pipeline layout");
+  }
+
+  VkComputePipelineCreateInfo pipeline_ci{
+      .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+      .flags = flags | (m_pipeline_executable_info ? VK_PIPELINE_CREATE_CAPTURE_STATISTICS_BIT_KHR |
+                                                         VK_PIPELINE_CREATE_CAPTURE_INTERNAL_REPRESENTATIONS_BIT_KHR
+                                                   : 0),
+      .stage =
+          {
+              .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+              .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+              .module = shader_module,
+              .pName = "main",
+              .pSpecializationInfo = specialization,
+          },
+      .layout = layout,
+  };
+  VkPipeline pipeline;
+  if (vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipeline_ci, m_allocation_callbacks, &pipeline) !=
+      VK_SUCCESS) {
+    vkDestroyPipelineLayout(m_device, layout, m_allocation_callbacks);
+    vkDestroyShaderModule(m_device, shader_module, m_allocation_callbacks);
+    throw std::runtime_error("unable to create compute pipeline");
+  }
+  return {*this, shader_module, layout, pipeline};
+}
@@ -2,24 +2,55 @@
 #pragma once
 
 #include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include <vulkan/vulkan_core.h>
 
 class Context;
 
+class Memory {
+  friend Context;
+
+  const Context &m_context;
+  const VkDeviceMemory m_handle;
+  const VkDeviceSize m_size;
+  const std::uint32_t m_memory_type;
+
+  Memory(const Context &context, VkDeviceMemory handle, VkDeviceSize size, std::uint32_t memory_type)
+      : m_context(context), m_handle(handle), m_size(size), m_memory_type(memory_type) {}
+
+public:
+  Memory(const Memory &) = delete;
+  Memory(Memory &&) = delete;
+  ~Memory();
+
+  VkDeviceMemory handle() const { return m_handle; }
+  VkDeviceSize size() const { return m_size; }
+};
+
 class Buffer {
   friend Context;
 
   const Context &m_context;
   const VkBuffer m_handle;
-  const std::uint32_t m_size;
+  const VkDeviceSize m_size;
+  const VkBufferUsageFlags m_usage;
   std::optional<VkDeviceMemory> m_allocation;
+  std::uint32_t m_memory_type = 0;
+  VkDeviceSize m_allocation_size = 0;
   bool m_mapped;
+  bool m_placed = false;
 
-  Buffer(const Context &context, VkBuffer handle, std::uint32_t size)
-      : m_context(context), m_handle(handle), m_size(size), m_mapped(false) {}
+  Buffer(const Context &context, VkBuffer handle, VkDeviceSize size, VkBufferUsageFlags usage)
+      : m_context(context), m_handle(handle), m_size(size), m_usage(usage), m_mapped(false) {}
 
 public:
   Buffer(const Buffer &) = delete;
@@ -27,11 +58,26 @@ public:
   ~Buffer();
 
   VkDeviceMemory allocate(std::uint32_t memory_type_mask);
+  // Binds the buffer to memory owned by someone else, which must outlive it
+  void bind(const Memory &memory, VkDeviceSize offset);
   std::span<std::uint8_t> mmap();
+  // Maps the whole allocation at address, which the caller has reserved (for
+  // example with a PROT_NONE mmap) for at least allocation_size() bytes and
+  // aligned to Context::placed_map_alignment. The range stays reserved after
+  // munmap. Needs Context::placed_memory_map.
+  std::span<std::uint8_t> mmap_placed(void *address);
   void munmap();
 
+  VkMemoryRequirements memory_requirements() const;
+  VkDeviceAddress device_address() const;
+
   VkBuffer handle() const { return m_handle; }
-  std::uint32_t size() const { return m_size; }
+  VkDeviceSize size() const { return m_size; }
+  // Size of the memory allocated by allocate, which can exceed size()
+  VkDeviceSize allocation_size() const { return m_allocation_size; }
+  // Index of the memory type chosen by allocate
+  std::uint32_t memory_type() const { return m_memory_type; }
+  VkBufferUsageFlags usage() const { return m_usage; }
   std::optional<VkDeviceMemory> allocation() const { return m_allocation; }
 };
 
@@ -53,29 +99,251 @@ public:
   VkFence handle() const { return m_fence; }
 };
 
+class CommandBuffer {
+  friend Context;
+
+  const Context &m_context;
+  const VkCommandBuffer m_handle;
+
+  CommandBuffer(const Context &context, VkCommandBuffer handle) : m_context(context), m_handle(handle) {}
+
+public:
+  CommandBuffer(const CommandBuffer &) = delete;
+  CommandBuffer(CommandBuffer &&) = delete;
+  ~CommandBuffer();
+
+  void begin() const;
+  void end() const;
+  void submit(const Fence &fence) const;
+
+  VkCommandBuffer handle() const { return m_handle; }
+};
+
+class QueryPool {
+  friend Context;
+
+  const Context &m_context;
+  const VkQueryPool m_handle;
+  const std::uint32_t m_count;
+
+  QueryPool(const Context &context, VkQueryPool handle, std::uint32_t count)
+      : m_context(context), m_handle(handle), m_count(count) {}
+
+public:
+  QueryPool(const QueryPool &) = delete;
+  QueryPool(QueryPool &&) = delete;
+  ~QueryPool();
+
+  // Blocks until all queries are available.
+  std::vector<std::uint64_t> results() const;
+
+  VkQueryPool handle() const { return m_handle; }
+  std::uint32_t count() const { return m_count; }
+};
+
+struct PipelineStatistic {
+  std::string name;
+  std::string value;
+};
+
+struct PipelineInternalRepresentation {
+  std::string name;
+  bool text;
+  std::string data;
+};
+
+// Compiler output for one executable of a pipeline, from
+// VK_KHR_pipeline_executable_properties
+struct PipelineExecutable {
+  std::string name;
+  std::uint32_t subgroup_size;
+  std::vector<PipelineStatistic> statistics;
+  std::vector<PipelineInternalRepresentation> internal_representations;
+};
+
+class ComputePipeline {
+  friend Context;
+
+  const Context &m_context;
+  const VkShaderModule m_shader_module;
+  const VkPipelineLayout m_layout;
+  const VkPipeline m_handle;
+
+  ComputePipeline(const Context &context, VkShaderModule shader_module, VkPipelineLayout layout, VkPipeline handle)
+      : m_context(context), m_shader_module(shader_module), m_layout(layout), m_handle(handle) {}
+
+public:
+  ComputePipeline(const ComputePipeline &) = delete;
+  ComputePipeline(ComputePipeline &&) = delete;
+  ~ComputePipeline();
+
+  // Empty if the device does not support pipeline executable properties
+  std::vector<PipelineExecutable> executables() const;
+
+  VkPipeline handle() const { return m_handle; }
+  VkPipelineLayout layout() const { return m_layout; }
+};
+
+struct MemoryReportTotals {
+  // VkDeviceMemory allocated through the API
+  std::uint64_t allocated_bytes = 0;
+  std::uint64_t allocation_count = 0;
+  // Memory the driver allocated for itself, keyed by the object it backs
+  std::map<VkObjectType, std::uint64_t> internal_bytes;
+  std::uint64_t internal_count = 0;
+  std::uint64_t imported_bytes = 0;
+  std::uint64_t import_count = 0;
+  std::uint64_t freed_bytes = 0;
+  std::uint64_t free_count = 0;
+  std::uint64_t failed_count = 0;
+  // Everything the driver holds, as of the last event
+  std::uint64_t live_bytes = 0;
+  std::uint64_t peak_bytes = 0;
+};
+
+// Collects VK_EXT_device_memory_report events for one device. The driver can
+// report from any thread.
+class MemoryReport {
+  mutable std::mutex m_mutex;
+  MemoryReportTotals m_totals;
+  // Sizes of live memory objects, as free events do not carry one
+  std::unordered_map<std::uint64_t, VkDeviceSize> m_live_objects;
+
+  void record(const VkDeviceMemoryReportCallbackDataEXT &data);
+
+public:
+  static VKAPI_ATTR void VKAPI_CALL callback(const VkDeviceMemoryReportCallbackDataEXT *data, void *user_data);
+
+  // Starts a new phase: clears the counters and restarts the peak from the
+  // memory that is live now
+  void reset();
+  MemoryReportTotals totals() const;
+};
+
+// Memory held through a context, with high-water marks since the last reset
+struct Footprint {
+  std::uint64_t mapped_bytes = 0;
+  std::uint64_t peak_mapped_bytes = 0;
+  std::uint64_t device_local_bytes = 0;
+  std::uint64_t peak_device_local_bytes = 0;
+};
+
+enum class Robustness {
+  none,
+  // robustBufferAccess
+  robust_buffer_access,
+  // robustBufferAccess2 from VK_EXT_robustness2, on top of robustBufferAccess
+  robust_buffer_access_2,
+};
+
 class Context {
+  friend Memory;
   friend Buffer;
 
+  const bool m_validation_enabled;
+  const Robustness m_robustness;
+  // Passed to every call that creates or destroys an object
+  const VkAllocationCallbacks *const m_allocation_callbacks;
   VkInstance m_instance = nullptr;
   VkPhysicalDevice m_physical_device = nullptr;
   VkQueue m_compute_queue = nullptr;
   VkDevice m_device = nullptr;
   VkCommandPool m_compute_command_pool = nullptr;
+  std::vector<const char *> m_enabled_extensions;
+  bool m_pipeline_executable_info = false;
+  bool m_shader_float16 = false;
+  bool m_placed_memory_map = false;
+  VkDeviceSize m_placed_map_alignment = 0;
+  // From VK_KHR_map_memory2, set with m_placed_memory_map
+  PFN_vkMapMemory2KHR m_map_memory2 = nullptr;
+  PFN_vkUnmapMemory2KHR m_unmap_memory2 = nullptr;
+  // Only present if the device supports VK_EXT_device_memory_report
+  std::unique_ptr<MemoryReport> m_memory_report;
+  VkPhysicalDeviceMemoryProperties m_memory_properties{};
+  mutable Footprint m_footprint;
 
-  void create_instance(bool validation_enabled);
+  void create_instance();
   void create_device();
 
-  std::optional<std::uint32_t> find_memory_type(std::uint32_t flags) const;
+  std::optional<std::uint32_t> find_memory_type(std::uint32_t flags, std::uint32_t type_mask = ~0u) const;
+  // Called by the objects that own allocations and mappings
+  void track_allocation(std::uint32_t memory_type, VkDeviceSize size, bool allocated) const;
+  void track_mapping(VkDeviceSize size, bool mapped) const;
 
 public:
-  Context(bool validation_enabled);
+  // allocation_callbacks, if set, must outlive the context
+  Context(bool validation_enabled, Robustness robustness = Robustness::none,
+          const VkAllocationCallbacks *allocation_callbacks = nullptr);
   Context(const Context &) = delete;
   Context(Context &&) = delete;
   ~Context();
 
-  Buffer create_buffer(std::uint32_t size, std::uint32_t usage) const;
+  Buffer create_buffer(VkDeviceSize size, std::uint32_t usage) const;
+  // What create_buffer(size, usage) would need, without creating it
+  VkMemoryRequirements buffer_memory_requirements(VkDeviceSize size, std::uint32_t usage) const;
+  Memory allocate_memory(VkDeviceSize size, std::uint32_t flags, std::uint32_t type_mask,
+                         VkMemoryAllocateFlags allocate_flags = 0) const;
   Fence create_fence() const;
+  CommandBuffer create_command_buffer() const;
+  QueryPool create_timestamp_query_pool(std::uint32_t count) const;
+  ComputePipeline create_compute_pipeline(std::span<const std::uint32_t> code, std::uint32_t push_constant_size,
+                                          std::span<const VkDescriptorSetLayout> set_layouts = {},
+                                          const VkSpecializationInfo *specialization = nullptr,
+                                          VkPipelineCreateFlags flags = 0) const;
+
+  // Whether a memory type with exactly these property flags exists
+  const VkPhysicalDeviceMemoryProperties &memory_properties() const { return m_memory_properties; }
+  bool has_memory_type(std::uint32_t flags) const { return find_memory_type(flags).has_value(); }
+  // Property flags of the memory type that has all of the required flags and
+  // the fewest others, if there is one. Drivers combine flags differently, so
+  // for example host-cached memory may or may not also be host-coherent.
+  std::optional<std::uint32_t> memory_flags_with(std::uint32_t required) const;
+  // Size of the heap that allocate_memory(size, flags, type_mask) would
+  // allocate from, or 0 if there is no such memory type
+  VkDeviceSize heap_size(std::uint32_t flags, std::uint32_t type_mask = ~0u) const;
+  // Index of that heap, if there is such a memory type
+  std::optional<std::uint32_t> heap_index(std::uint32_t flags, std::uint32_t type_mask = ~0u) const;
+  // Bytes that can still be allocated from a heap while leaving room for the
+  // driver and other processes: the budget from VK_EXT_memory_budget less
+  // what this process uses, or three quarters of the heap without it
+  VkDeviceSize heap_budget(std::uint32_t heap_index) const;
+
+  // Whether an optional device extension was enabled
+  bool has_extension(std::string_view name) const;
+
+  template <typename T>
+  T device_function(const char *name) const {
+    return reinterpret_cast<T>(vkGetDeviceProcAddr(m_device, name));
+  }
+
+  // Nanoseconds per timestamp tick
+  float timestamp_period() const;
+
+  // Restarts the high-water marks from the memory that is held now
+  void reset_footprint() const;
+  const Footprint &footprint() const { return m_footprint; }
+  // Counts the peaks of another context, such as one that a benchmark creates
+  // with different device features, as held on top of the memory held now
+  void add_footprint(const Footprint &other) const;
+  // Bytes in use on device-local heaps by every process, from
+  // VK_EXT_memory_budget if available
+  std::optional<VkDeviceSize> device_local_heap_usage() const;
 
+  bool validation_enabled() const { return m_validation_enabled; }
+  Robustness robustness() const { return m_robustness; }
+  // Host allocation callbacks for the driver, or nullptr for its own
+  const VkAllocationCallbacks *allocation_callbacks() const { return m_allocation_callbacks; }
+  // Whether compute pipelines capture compiler statistics
+  bool pipeline_executable_info() const { return m_pipeline_executable_info; }
+  // Whether kernels can use 16-bit float arithmetic
+  bool shader_float16() const { return m_shader_float16; }
+  // Whether Buffer::mmap_placed is available, which needs memoryMapPlaced and
+  // memoryUnmapReserve from VK_EXT_map_memory_placed
+  bool placed_memory_map() const { return m_placed_memory_map; }
+  // Alignment of the addresses given to Buffer::mmap_placed
+  VkDeviceSize placed_map_alignment() const { return m_placed_map_alignment; }
+  // Driver memory events, or nullptr if the device does not report them
+  MemoryReport *memory_report() const { return m_memory_report.get(); }
   VkInstance instance() const { return m_instance; }
   VkPhysicalDevice physical_device() const { return m_physical_device; }
   VkDevice device() const { return m_device; }
@@ -1,107 +1,867 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
+#include "alias_planner.hh"
+#include "benchmark.hh"
+#include "chart.hh"
+#include "environment.hh"
+#include "host_allocator.hh"
+#include "hostcopy.hh"
+#include "results_cache.hh"
+#include "shaders.hh"
+#include "suite.hh"
 #include "vkcontext.hh"
 
 #include <algorithm>
 #include <array>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <filesystem>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
 #include <span>
+#include <stdexcept>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 #include <vulkan/vulkan_core.h>
 
-void copy_benchmark(Context &context, std::uint64_t buffer_size) {
-  VkPhysicalDeviceProperties physical_properties;
-  vkGetPhysicalDeviceProperties(context.physical_device(), &physical_properties);
-  // nanos in one timestamp tick
-  float period = physical_properties.limits.timestampPeriod;
+namespace {
 
-  Buffer src = context.create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
-  src.allocate(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-  std::span<std::uint8_t> data = src.mmap();
-  std::fill(data.begin(), data.end(), 0xff);
+struct CopyPath {
+  const char *name;
+  std::uint32_t src_flags;
+  std::uint32_t dst_flags;
+};
 
-  Buffer dst = context.create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
-  dst.allocate(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+constexpr std::array copy_paths{
+    CopyPath{"host-to-device", VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT},
+    CopyPath{"device-to-device", VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT},
+    CopyPath{"device-to-host", VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT},
+};
 
-  VkQueryPoolCreateInfo query_pool_ci{
-      .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
-      .queryType = VK_QUERY_TYPE_TIMESTAMP,
-      .queryCount = 2,
-  };
-  VkQueryPool query_pool;
-  vkCreateQueryPool(context.device(), &query_pool_ci, nullptr, &query_pool);
+// The paths that the copy sweep covers, only host-to-device unless
+// --all-copy-paths is given
+std::span<const CopyPath> swept_copy_paths(copy_paths.data(), 1);
 
-  Fence transfer_fence = context.create_fence();
+constexpr const char *copy_bandwidth_chart_name = "copy_bandwidth.svg";
+constexpr const char *copy_latency_chart_name = "copy_latency.svg";
 
-  // Allocate command buffer
-  VkCommandBufferAllocateInfo command_buffer_ai{
-      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-      .commandPool = context.compute_command_pool(),
-      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-      .commandBufferCount = 1,
-  };
-  VkCommandBuffer command_buffer;
-  vkAllocateCommandBuffers(context.device(), &command_buffer_ai, &command_buffer);
+// Sizes from 1 MiB to 1 GiB in powers of two
+constexpr int copy_size_count = 11;
 
-  // Record command buffer with single copy command
-  VkCommandBufferBeginInfo command_buffer_begin_info{
-      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-  };
-  vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info);
-  // Could split the copy up into multiple smaller copies, but this
-  // didn't seem to make a performance difference with RADV (which
-  // doesn't use hardware transfer queues).
-  VkBufferCopy copy{
-      .srcOffset = 0,
-      .dstOffset = 0,
-      .size = buffer_size,
-  };
-  vkCmdResetQueryPool(command_buffer, query_pool, 0, 2);
-  vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_NONE, query_pool, 0);
-  vkCmdCopyBuffer(command_buffer, src.handle(), dst.handle(), 1, &copy);
-  vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_COPY_BIT, query_pool, 1);
-  vkEndCommandBuffer(command_buffer);
-
-  // Submit command buffer to queue
-  VkSubmitInfo submit_info{
-      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-      .commandBufferCount = 1,
-      .pCommandBuffers = &command_buffer,
-  };
+std::uint64_t copy_size(int index) { return 1024ull * 1024 * (1 << index); }
+
+enum class CopyMethod {
+  // vkCmdCopyBuffer
+  command,
+  // src/shaders/copy.comp
+  kernel,
+};
+
+// Sources can also be fill destinations, for when they are bound to memory
+// that cannot be mapped through them
+constexpr VkBufferUsageFlags kernel_copy_usage =
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+constexpr VkBufferUsageFlags command_src_usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+constexpr VkBufferUsageFlags command_dst_usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+// Memory that a CopyCase binds its buffers to instead of allocating them
+struct CopyPlacement {
+  const Memory &src_memory;
+  VkDeviceSize src_offset;
+  const Memory &dst_memory;
+  VkDeviceSize dst_offset;
+  // Whether other buffers use any of the memory, before the copies or between
+  // them. Every copy then starts with record_alias_barrier.
+  bool aliased;
+};
+
+// Buffers and a recorded copy command buffer for one path and size
+struct CopyCase {
+  CopyCase(const Context &context, const CopyPath &path, std::uint64_t size,
+           CopyMethod method = CopyMethod::command, const CopyPlacement *placement = nullptr)
+      : context(context),
+        src(context.create_buffer(size, method == CopyMethod::command ? command_src_usage : kernel_copy_usage)),
+        dst(context.create_buffer(size, method == CopyMethod::command ? command_dst_usage : kernel_copy_usage)),
+        query_pool(context.create_timestamp_query_pool(2)), transfer_fence(context.create_fence()),
+        command_buffer(context.create_command_buffer()) {
+    if (placement) {
+      src.bind(placement->src_memory, placement->src_offset);
+      dst.bind(placement->dst_memory, placement->dst_offset);
+      fill_placed_src(placement->aliased);
+    } else {
+      src.allocate(path.src_flags);
+      if (path.src_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        std::span<std::uint8_t> data = src.mmap();
+        host_fill(src, data, 0xff);
+      }
+      dst.allocate(path.dst_flags);
+    }
+
+    // Record command buffer with single copy command
+    command_buffer.begin();
+    // Could split the copy up into multiple smaller copies, but this
+    // didn't seem to make a performance difference with RADV (which
+    // doesn't use hardware transfer queues).
+    VkBufferCopy copy{
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size = size,
+    };
+    vkCmdResetQueryPool(command_buffer.handle(), query_pool.handle(), 0, 2);
+    if (placement && placement->aliased) {
+      record_alias_barrier(command_buffer);
+    }
+    vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_NONE, query_pool.handle(), 0);
+    if (method == CopyMethod::command) {
+      vkCmdCopyBuffer(command_buffer.handle(), src.handle(), dst.handle(), 1, &copy);
+      vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_COPY_BIT, query_pool.handle(), 1);
+    } else {
+      pipeline.reset(new ComputePipeline(context.create_compute_pipeline(shaders::copy, sizeof(CopyPushConstants))));
+      record_kernel_copy(command_buffer, *pipeline, src, dst, size);
+      vkCmdWriteTimestamp2(command_buffer.handle(), VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, query_pool.handle(), 1);
+    }
+    command_buffer.end();
+  }
+
+  // GPU seconds of one copy
+  double run() const { return timed_submit(context, command_buffer, transfer_fence, query_pool); }
+
+  // Fills the source on the device, as its memory is shared and not mapped.
+  // Memory that held other buffers has undefined contents and needs their
+  // accesses ordered before the fill.
+  void fill_placed_src(bool aliased) const {
+    CommandBuffer setup = context.create_command_buffer();
+    setup.begin();
+    if (aliased) {
+      record_alias_barrier(setup);
+    }
+    vkCmdFillBuffer(setup.handle(), src.handle(), 0, VK_WHOLE_SIZE, 0xffffffff);
+    record_alias_barrier(setup);
+    setup.end();
+    setup.submit(transfer_fence);
+    transfer_fence.wait();
+    transfer_fence.reset();
+  }
 
-  float total_seconds = 0;
+  const Context &context;
+  Buffer src;
+  Buffer dst;
+  QueryPool query_pool;
+  Fence transfer_fence;
+  CommandBuffer command_buffer;
+  // Only for CopyMethod::kernel
+  std::unique_ptr<ComputePipeline> pipeline;
+};
+
+// Configurations that --compare can set against each other. Their memory
+// flags are the ones required, see resolve_copy_path.
+struct CopyVariant {
+  std::string_view name;
+  CopyPath path;
+  CopyMethod method;
+};
+
+constexpr std::uint32_t coherent_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+constexpr std::uint32_t cached_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+constexpr std::array copy_variants{
+    CopyVariant{"copy-command", copy_paths[1], CopyMethod::command},
+    CopyVariant{"copy-kernel", copy_paths[1], CopyMethod::kernel},
+    CopyVariant{"staging-coherent", {"host-to-device", coherent_flags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT},
+                CopyMethod::command},
+    CopyVariant{"staging-cached", {"host-to-device", cached_flags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT},
+                CopyMethod::command},
+    CopyVariant{"readback-coherent", {"device-to-host", VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, coherent_flags},
+                CopyMethod::command},
+    CopyVariant{"readback-cached", {"device-to-host", VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, cached_flags},
+                CopyMethod::command},
+};
+
+constexpr std::uint64_t default_compare_size = 64 * 1024 * 1024;
+constexpr int compare_pair_count = 64;
+
+} // namespace
+
+// Returns the average GPU seconds of one copy
+double copy_benchmark(Context &context, const CopyPath &path, std::uint64_t buffer_size) {
+  CopyCase copy_case(context, path, buffer_size);
+
+  double total_seconds = 0;
   std::uint64_t total_bytes = 0;
 
   // This has the overhead of round trip latency between CPU and
   // GPU. Instead, could have multiple copy buffer commands and submit
   // those at the same time.
   for (int count = 0; count < 32; count++) {
-    vkQueueSubmit(context.compute_queue(), 1, &submit_info, transfer_fence.handle());
+    total_seconds += copy_case.run();
+    total_bytes += buffer_size;
+  }
 
-    transfer_fence.wait();
-    transfer_fence.reset();
+  std::cout << buffer_size / 1024 / 1024 << " MiB @ " << mib_per_second(total_bytes, total_seconds) << " MiB/sec\n";
+  return total_seconds / 32;
+}
 
-    std::array<std::uint64_t, 2> timestamps;
-    vkGetQueryPoolResults(context.device(), query_pool, 0, 2, timestamps.size() * sizeof(std::uint64_t),
-                          timestamps.data(), sizeof(std::uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+// Source and destination of a copy, both live in step
+void add_copy_requests(const Context &context, const CopyPath &path, std::uint64_t size, CopyMethod method, int step,
+                       std::vector<AliasRequest> &requests) {
+  const bool command = method == CopyMethod::command;
+  const VkMemoryRequirements src =
+      context.buffer_memory_requirements(size, command ? command_src_usage : kernel_copy_usage);
+  const VkMemoryRequirements dst =
+      context.buffer_memory_requirements(size, command ? command_dst_usage : kernel_copy_usage);
+  requests.push_back({src.size, src.alignment, path.src_flags, src.memoryTypeBits, step, step});
+  requests.push_back({dst.size, dst.alignment, path.dst_flags, dst.memoryTypeBits, step, step});
+}
 
-    double seconds = static_cast<double>(timestamps[1] - timestamps[0]) * period / 1e9f;
+// Whether the pools fit the budgets of their heaps together, as pools with
+// different flags can share a heap
+bool fits_budget(const Context &context, std::span<const AliasPool> pools) {
+  std::map<std::uint32_t, VkDeviceSize> heap_bytes;
+  for (const AliasPool &pool : pools) {
+    const std::optional<std::uint32_t> heap = context.heap_index(pool.flags, pool.type_mask);
+    if (!heap) {
+      return false;
+    }
+    heap_bytes[*heap] += pool.size;
+  }
+  for (const auto &[heap, bytes] : heap_bytes) {
+    if (bytes > context.heap_budget(heap)) {
+      return false;
+    }
+  }
+  return true;
+}
 
-    total_seconds += seconds;
-    total_bytes += buffer_size;
+// Number of sweep sizes, from the smallest, whose source and destination fit
+// the heap budgets for every path. Each copy allocates its buffers and frees
+// them before the next, so the largest copy is the peak.
+int fitting_copy_size_count(const Context &context) {
+  for (int i = 0; i < copy_size_count; i++) {
+    for (const CopyPath &path : swept_copy_paths) {
+      std::vector<AliasRequest> requests;
+      add_copy_requests(context, path, copy_size(i), CopyMethod::command, 0, requests);
+      if (!fits_budget(context, plan_aliases(requests).pools)) {
+        return i;
+      }
+    }
+  }
+  return copy_size_count;
+}
+
+void copy_sweep(Context &context) {
+  LogLogChart bandwidth_chart{
+      .title = "Copy bandwidth (compute queue)",
+      .x_label = "size (MiB)",
+      .y_label = "MiB/sec",
+  };
+  LogLogChart latency_chart{
+      .title = "Copy time (compute queue)",
+      .x_label = "size (MiB)",
+      .y_label = "ms",
+  };
+
+  const int size_count = fitting_copy_size_count(context);
+  if (size_count == 0) {
+    std::cout << "copy sweep skipped, not even " << copy_size(0) / 1024 / 1024 << " MiB copies fit in memory\n";
+    return;
+  }
+  if (size_count < copy_size_count) {
+    std::cout << "skipping copies of " << copy_size(size_count) / 1024 / 1024
+              << " MiB and up, they do not fit in the heap budget\n";
+  }
+
+  for (const CopyPath &path : swept_copy_paths) {
+    std::cout << path.name << " copy (compute queue)\n--------------------\n";
+    ChartSeries bandwidth_series{path.name, {}, true};
+    ChartSeries latency_series{path.name, {}, true};
+    std::vector<double> bandwidths;
+    for (int i = 0; i < size_count; i++) {
+      const std::uint64_t size = copy_size(i);
+      const double seconds = copy_benchmark(context, path, size);
+      bandwidths.push_back(mib_per_second(size, seconds));
+      bandwidth_series.points.push_back({static_cast<double>(size / 1024 / 1024), bandwidths.back()});
+      latency_series.points.push_back({static_cast<double>(size / 1024 / 1024), seconds * 1e3});
+    }
+    const auto [min, max] = std::minmax_element(bandwidths.begin(), bandwidths.end());
+    std::cout << "1 MiB " << sparkline(bandwidths) << ' ' << copy_size(size_count - 1) / 1024 / 1024 << " MiB ("
+              << *min << " .. " << *max << " MiB/sec)\n";
+    bandwidth_chart.series.push_back(std::move(bandwidth_series));
+    latency_chart.series.push_back(std::move(latency_series));
+  }
+
+  write_chart(copy_bandwidth_chart_name, bandwidth_chart);
+  write_chart(copy_latency_chart_name, latency_chart);
+}
+
+// The sizes that fit depend on the heap budget left by other processes
+std::string copy_parameters(const Context &context) {
+  return "copy_paths=" + std::to_string(swept_copy_paths.size()) +
+         "\ncopy_sizes=" + std::to_string(fitting_copy_size_count(context)) + '\n';
+}
+
+// The copy sweep as suite points, so that a time budget decides how often
+// each path and size is sampled
+std::vector<SuitePoint> copy_points(Context &context) {
+  // Points prepare their cases lazily and release them before the next point,
+  // so as in the sweep only one copy holds memory at a time
+  const int size_count = fitting_copy_size_count(context);
+  std::vector<SuitePoint> points;
+  for (const CopyPath &path : swept_copy_paths) {
+    for (int i = 0; i < size_count; i++) {
+      const std::uint64_t size = copy_size(i);
+      points.push_back({
+          .name = std::string("copy ") + path.name + ' ' + std::to_string(size / 1024 / 1024) + " MiB",
+          .bytes = size,
+          .prepare =
+              [&context, &path, size] {
+                auto copy_case = std::make_shared<CopyCase>(context, path, size);
+                return std::function<double()>([copy_case] { return copy_case->run(); });
+              },
+      });
+    }
+  }
+  return points;
+}
+
+const CopyVariant *find_copy_variant(std::string_view name) {
+  for (const CopyVariant &variant : copy_variants) {
+    if (variant.name == name) {
+      return &variant;
+    }
+  }
+  return nullptr;
+}
+
+// The variant's path with the flags of the memory types it will use. The host
+// never accesses the memory of a comparison, as the sources are filled on the
+// device, so host-cached memory works without flushes whether it is coherent
+// or not.
+CopyPath resolve_copy_path(const Context &context, const CopyVariant &variant) {
+  const std::optional<std::uint32_t> src_flags = context.memory_flags_with(variant.path.src_flags);
+  const std::optional<std::uint32_t> dst_flags = context.memory_flags_with(variant.path.dst_flags);
+  if (!src_flags || !dst_flags) {
+    throw std::runtime_error(std::string("no memory type for ") + std::string(variant.name));
+  }
+  return {variant.path.name, *src_flags, *dst_flags};
+}
+
+// Alternates copies of the two variants and prints their paired difference.
+// Both variants are set up for the whole comparison but never copy at the
+// same time, so buffers with the same memory flags share memory.
+void compare_copy_variants(Context &context, const CopyVariant &a, const CopyVariant &b, std::uint64_t size,
+                           std::uint64_t seed) {
+  const std::array<const CopyVariant *, 2> variants{&a, &b};
+  std::array<CopyPath, 2> paths;
+  std::vector<AliasRequest> requests;
+  for (int i = 0; i < 2; i++) {
+    const CopyVariant &variant = *variants[i];
+    paths[i] = resolve_copy_path(context, variant);
+    add_copy_requests(context, paths[i], size, variant.method, i, requests);
+  }
+  const AliasPlan plan = plan_aliases(requests);
+  if (!fits_budget(context, plan.pools)) {
+    throw std::runtime_error("copies of this size do not fit in the heap budget");
+  }
+  const bool kernel = a.method == CopyMethod::kernel || b.method == CopyMethod::kernel;
+  AliasedMemory memory(context, plan, kernel ? VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT : 0);
+  const bool aliased = std::ranges::count(plan.reuses_memory, true) > 0;
+  VkDeviceSize aliased_size = 0;
+  for (const AliasPool &pool : plan.pools) {
+    aliased_size += pool.size;
+  }
+
+  std::array<SuitePoint, 2> points;
+  std::array<CopyPlacement, 2> placements{{
+      {memory.pool(plan.pool_indices[0]), plan.offsets[0], memory.pool(plan.pool_indices[1]), plan.offsets[1], aliased},
+      {memory.pool(plan.pool_indices[2]), plan.offsets[2], memory.pool(plan.pool_indices[3]), plan.offsets[3], aliased},
+  }};
+  for (int i = 0; i < 2; i++) {
+    const CopyVariant &variant = *variants[i];
+    points[i] = {
+        .name = std::string(variant.name),
+        .bytes = size,
+        .prepare =
+            [&context, &variant, &path = paths[i], &placement = placements[i], size] {
+              auto copy_case = std::make_shared<CopyCase>(context, path, size, variant.method, &placement);
+              return std::function<double()>([copy_case] { return copy_case->run(); });
+            },
+    };
+  }
+
+  const PairedResult result = compare_paired(points[0], points[1], compare_pair_count, seed);
+  std::cout << a.name << " vs " << b.name << " (" << size / 1024 / 1024 << " MiB, " << result.pair_count
+            << " alternating pairs, seed " << seed << ")\n--------------------\n";
+  // Without aliasing, each variant holds its own buffers for the whole
+  // comparison
+  std::cout << "memory " << aliased_size / 1024 / 1024 << " MiB in " << plan.pools.size() << " allocations, instead of "
+            << unaliased_size(requests) / 1024 / 1024 << " MiB\n";
+  std::cout << a.name << " @ " << mib_per_second(size, result.mean_a_seconds) << " MiB/sec\n";
+  std::cout << b.name << " @ " << mib_per_second(size, result.mean_b_seconds) << " MiB/sec\n";
+  const double low = result.relative_difference - result.confidence_half_width;
+  const double high = result.relative_difference + result.confidence_half_width;
+  std::cout << b.name << " time relative to " << a.name << ": " << result.relative_difference * 100
+            << "% (95% CI " << low * 100 << "% .. " << high * 100 << "%), "
+            << (low > 0 ? "slower" : high < 0 ? "faster" : "no significant difference") << '\n';
+  if (kernel) {
+    ComputePipeline pipeline = context.create_compute_pipeline(shaders::copy, sizeof(CopyPushConstants));
+    print_pipeline_statistics("copy kernel", pipeline.executables());
   }
+}
+
+namespace {
+
+// Cached results older than this are measured again
+constexpr std::chrono::hours default_max_age{24 * 7};
+
+// Samples of every point per round with --rounds
+constexpr int round_sample_count = 4;
+
+struct Benchmark {
+  std::string_view name;
+  void (*run)(Context &);
+  // Set if the benchmark writes mapped memory with host_copy or host_fill,
+  // whose kernels are then tuned before it first runs
+  bool host_copies = false;
+  // Set if the benchmark writes charts with write_chart
+  bool charts = false;
+  // Set if the benchmark can run as suite points under --budget
+  std::vector<SuitePoint> (*points)(Context &) = nullptr;
+  // Set if what the benchmark measures depends on the state of the device,
+  // such as the memory free now. "name=value" lines for the cache key.
+  std::string (*parameters)(const Context &) = nullptr;
+};
+
+constexpr std::array benchmarks{
+    Benchmark{"copy", copy_sweep, false, true, copy_points, copy_parameters},
+    Benchmark{"usage", usage_benchmark, true, false, usage_points},
+    Benchmark{"objects", object_count_benchmark, true},
+    Benchmark{"live-allocations", live_allocation_benchmark, true},
+    Benchmark{"binding", binding_benchmark, true},
+    Benchmark{"copy-list", copy_list_benchmark, true},
+    Benchmark{"robustness", robustness_benchmark},
+    Benchmark{"pipelines", pipeline_statistics_benchmark},
+    Benchmark{"first-use", first_use_benchmark, true},
+    Benchmark{"page-stride", page_stride_benchmark, false, true, page_stride_points},
+    Benchmark{"partition-stride", partition_stride_benchmark, false, false, partition_stride_points},
+    Benchmark{"roofline", roofline_benchmark, false, true},
+    Benchmark{"query-retrieval", query_retrieval_benchmark},
+    Benchmark{"placed-map", placed_map_benchmark},
+    Benchmark{"host-allocator", host_allocator_benchmark},
+    Benchmark{"write-combining", write_combining_benchmark},
+};
+
+const Benchmark *find_benchmark(std::string_view name) {
+  for (const Benchmark &benchmark : benchmarks) {
+    if (benchmark.name == name) {
+      return &benchmark;
+    }
+  }
+  return nullptr;
+}
+
+const char *object_type_name(VkObjectType type) {
+  switch (type) {
+  case VK_OBJECT_TYPE_DEVICE:
+    return "device";
+  case VK_OBJECT_TYPE_QUEUE:
+    return "queue";
+  case VK_OBJECT_TYPE_COMMAND_POOL:
+    return "command pool";
+  case VK_OBJECT_TYPE_COMMAND_BUFFER:
+    return "command buffer";
+  case VK_OBJECT_TYPE_BUFFER:
+    return "buffer";
+  case VK_OBJECT_TYPE_QUERY_POOL:
+    return "query pool";
+  case VK_OBJECT_TYPE_SHADER_MODULE:
+    return "shader module";
+  case VK_OBJECT_TYPE_PIPELINE:
+    return "pipeline";
+  case VK_OBJECT_TYPE_DESCRIPTOR_POOL:
+    return "descriptor pool";
+  case VK_OBJECT_TYPE_DESCRIPTOR_SET:
+    return "descriptor set";
+  default:
+    return "other";
+  }
+}
+
+void print_footprint(const Context &context, std::optional<VkDeviceSize> heap_usage_before) {
+  const Footprint &footprint = context.footprint();
+  std::cout << "footprint: peak RSS " << peak_rss_bytes() / 1024 / 1024 << " MiB, peak mapped "
+            << footprint.peak_mapped_bytes / 1024 / 1024 << " MiB, peak device-local "
+            << footprint.peak_device_local_bytes / 1024 / 1024 << " MiB";
+  // Sampled only around the run, so unlike the peaks it misses memory that
+  // came and went in between. It covers every process, drivers included.
+  std::optional<VkDeviceSize> heap_usage = context.device_local_heap_usage();
+  if (heap_usage_before && heap_usage) {
+    std::cout << "; device-local heap usage before/after " << *heap_usage_before / 1024 / 1024 << " -> "
+              << *heap_usage / 1024 / 1024 << " MiB";
+  }
+  std::cout << '\n';
+}
+
+// Driver memory that came and went while one benchmark ran
+void print_memory_report(const MemoryReportTotals &totals) {
+  std::cout << "driver memory: " << totals.allocation_count << " allocations " << totals.allocated_bytes
+            << " B, " << totals.internal_count << " internal, " << totals.import_count << " imports "
+            << totals.imported_bytes << " B, " << totals.free_count << " frees " << totals.freed_bytes << " B, "
+            << totals.failed_count << " failed, peak " << totals.peak_bytes << " B\n";
+  for (const auto &[type, bytes] : totals.internal_bytes) {
+    std::cout << "  internal " << object_type_name(type) << ": " << bytes << " B\n";
+  }
+}
+
+// Host allocations the driver made through the callbacks while one benchmark
+// ran
+void print_host_allocations(const HostAllocationTotals &totals) {
+  constexpr std::array<const char *, 5> scope_names{"command", "object", "cache", "device", "instance"};
+  std::cout << "host allocations: " << totals.allocation_count << " allocations " << totals.allocated_bytes
+            << " B, " << totals.reallocation_count << " reallocations, " << totals.free_count << " frees, "
+            << totals.failed_count << " failed, " << totals.seconds * 1e3 << " ms in callbacks, peak "
+            << totals.peak_bytes << " B";
+  if (totals.arena_count) {
+    std::cout << ", " << totals.arena_count << " from the arena";
+  }
+  std::cout << '\n';
+  for (std::size_t scope = 0; scope < scope_names.size(); scope++) {
+    if (totals.scope_counts[scope]) {
+      std::cout << "  " << scope_names[scope] << " scope: " << totals.scope_counts[scope] << '\n';
+    }
+  }
+  if (totals.internal_count) {
+    std::cout << "  internal: " << totals.internal_count << " allocations " << totals.internal_bytes << " B\n";
+  }
+}
 
-  std::cout << buffer_size / 1024 / 1024 << " MiB @ " << total_bytes / total_seconds / 1024 / 1024 << " MiB/sec\n";
+void print_suite_results(std::span<const SuitePoint> points, std::span<const SuiteResult> results) {
+  for (std::size_t i = 0; i < points.size(); i++) {
+    const SuiteResult &result = results[i];
+    if (result.sample_count == 0) {
+      std::cout << points[i].name << ": not measured, the budget ran out\n";
+      continue;
+    }
+    std::cout << points[i].name << ": " << result.mean_seconds * 1e3 << " ms";
+    if (points[i].bytes) {
+      std::cout << " @ " << mib_per_second(points[i].bytes, result.mean_seconds) << " MiB/sec";
+    }
+    std::cout << " +/- " << result.relative_error * 100 << "% (" << result.sample_count << " samples, "
+              << result.cost_seconds << " s)\n";
+  }
+}
 
-  vkDestroyQueryPool(context.device(), query_pool, nullptr);
+// Number after the '=' of a --name=value argument
+template <typename T> std::optional<T> option_value(std::string_view arg) {
+  const std::string_view value = arg.substr(arg.find('=') + 1);
+  T number;
+  const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), number);
+  if (error != std::errc() || end != value.data() + value.size()) {
+    return std::nullopt;
+  }
+  return number;
 }
 
-int main() {
-  Context context(true);
+// Runs the benchmark, or replays its cached output. The environment report
+// is cached with the output, so that a replay shows the state it was
+// measured in.
+void run_benchmark(Context &context, HostAllocator *host_allocator, const std::optional<ResultsCache> &cache,
+                   const std::string &environment, const std::string &environment_report,
+                   const Benchmark &benchmark) {
+  std::string key = environment + "benchmark=" + std::string(benchmark.name) + '\n';
+  if (benchmark.parameters) {
+    key += benchmark.parameters(context);
+  }
+  std::chrono::seconds age{};
+  if (std::optional<std::string> output = cache ? cache->load(key, age) : std::nullopt) {
+    std::cout << "[" << benchmark.name << ": cached " << age.count() / 60 << " min ago, in the environment below]\n"
+              << *output;
+    if (benchmark.charts && charts_enabled()) {
+      std::cout << "[charts are not regenerated from cached results, rerun with --no-cache]\n";
+    }
+    return;
+  }
+
+  // Tuned once, and only if a benchmark that is not replayed needs it
+  if (benchmark.host_copies && !host_copy_tuned()) {
+    tune_host_copy(context);
+    print_host_copy_selection();
+  }
 
-  std::cout << "host-to-device copy (compute queue)\n--------------------\n";
-  // TODO: Check memory size instead of assuming 1 GiB is available.
-  for (uint64_t i = 0; i < 11; i++) {
-    copy_benchmark(context, 1024ull * 1024 * (1 << i));
+  // Charts written by a benchmark are not cached, only its printed results
+  OutputCapture capture(std::cout);
+  if (MemoryReport *memory_report = context.memory_report()) {
+    memory_report->reset();
+  }
+  if (host_allocator) {
+    host_allocator->reset();
+  }
+  context.reset_footprint();
+  reset_peak_rss();
+  std::optional<VkDeviceSize> heap_usage_before = context.device_local_heap_usage();
+  benchmark.run(context);
+  print_footprint(context, heap_usage_before);
+  if (const MemoryReport *memory_report = context.memory_report()) {
+    print_memory_report(memory_report->totals());
+  }
+  if (host_allocator) {
+    print_host_allocations(host_allocator->totals());
+  }
+  if (cache) {
+    cache->store(key, environment_report + capture.output());
+  }
+}
+
+void print_usage(const char *program) {
+  std::cerr << "usage: " << program
+            << " [--no-cache] [--validation] [--max-age=HOURS] [--budget=SECONDS | --rounds=N] [--seed=N]\n"
+            << "       [--host-allocator=counting|arena] [--all-copy-paths] [--chart-dir=DIR] [benchmark...]\n"
+            << "       " << program << " --compare=A,B [--size=MIB] [--seed=N]\n\n"
+            << "Results are cached under " << ResultsCache::default_directory().string()
+            << " and replayed while the device, driver, heap sizes,\n"
+            << "kernel, vkmembench version and benchmark parameters are unchanged and the results are\n"
+            << "younger than --max-age (default " << default_max_age.count() << ").\n\n"
+            << "With --budget, benchmarks marked * are sampled as often as the time allows, with more\n"
+            << "samples for noisy and cheap points, and the others are skipped. With --rounds, they take\n"
+            << round_sample_count << " samples of every point per round, in a new random order every round. The "
+            << "order is\nreproduced by --seed. The others run once in full, not per round. No results are "
+            << "cached.\n\n"
+            << "--compare=A,B alternates copies of two variants, " << compare_pair_count << " pairs of "
+            << default_compare_size / 1024 / 1024 << " MiB or --size=MIB,\n"
+            << "and reports the paired difference with a 95% confidence interval.\n\n"
+            << "--host-allocator passes allocation callbacks to the driver and reports its host allocations\n"
+            << "per benchmark. arena serves small ones from free lists instead of the system heap.\n\n"
+            << "The copy sweep measures host-to-device copies, and with --all-copy-paths also\n"
+            << "device-to-device and device-to-host copies.\n\n"
+            << "--validation enables VK_LAYER_KHRONOS_validation, whose checks then dominate CPU-side timings.\n\n"
+            << "--chart-dir writes SVG charts of the copy, page-stride and roofline results into DIR.\n\n"
+            << "Variants:";
+  for (const CopyVariant &variant : copy_variants) {
+    std::cerr << ' ' << variant.name;
+  }
+  std::cerr << "\n\nbenchmarks:\n";
+  for (const Benchmark &benchmark : benchmarks) {
+    std::cerr << "  " << benchmark.name << (benchmark.points ? " *" : "") << '\n';
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::vector<const Benchmark *> selected;
+  bool use_cache = true;
+  bool validation = false;
+  std::chrono::hours max_age = default_max_age;
+  std::optional<double> budget_seconds;
+  std::optional<int> round_count;
+  std::uint64_t seed = std::random_device()();
+  std::array<const CopyVariant *, 2> compare{};
+  std::uint64_t compare_size = default_compare_size;
+  std::optional<HostAllocatorKind> host_allocator_kind;
+  for (int i = 1; i < argc; i++) {
+    const std::string_view arg = argv[i];
+    if (arg == "--no-cache") {
+      use_cache = false;
+      continue;
+    }
+    if (arg.starts_with("--chart-dir=")) {
+      const std::string_view directory = arg.substr(arg.find('=') + 1);
+      if (directory.empty()) {
+        print_usage(argv[0]);
+        return 1;
+      }
+      set_chart_directory(directory);
+      continue;
+    }
+    if (arg == "--validation") {
+      validation = true;
+      continue;
+    }
+    if (arg == "--all-copy-paths") {
+      swept_copy_paths = copy_paths;
+      continue;
+    }
+    if (arg.starts_with("--max-age=")) {
+      std::optional<int> hours = option_value<int>(arg);
+      if (!hours || *hours < 0) {
+        print_usage(argv[0]);
+        return 1;
+      }
+      max_age = std::chrono::hours(*hours);
+      continue;
+    }
+    if (arg.starts_with("--budget=")) {
+      budget_seconds = option_value<double>(arg);
+      if (!budget_seconds || !(*budget_seconds > 0)) {
+        print_usage(argv[0]);
+        return 1;
+      }
+      continue;
+    }
+    if (arg.starts_with("--rounds=")) {
+      round_count = option_value<int>(arg);
+      if (!round_count || *round_count < 1) {
+        print_usage(argv[0]);
+        return 1;
+      }
+      continue;
+    }
+    if (arg.starts_with("--seed=")) {
+      std::optional<std::uint64_t> value = option_value<std::uint64_t>(arg);
+      if (!value) {
+        print_usage(argv[0]);
+        return 1;
+      }
+      seed = *value;
+      continue;
+    }
+    if (arg.starts_with("--compare=")) {
+      const std::string_view names = arg.substr(arg.find('=') + 1);
+      const std::size_t comma = names.find(',');
+      if (comma != std::string_view::npos) {
+        compare = {find_copy_variant(names.substr(0, comma)), find_copy_variant(names.substr(comma + 1))};
+      }
+      if (!compare[0] || !compare[1]) {
+        print_usage(argv[0]);
+        return 1;
+      }
+      continue;
+    }
+    if (arg.starts_with("--size=")) {
+      std::optional<std::uint64_t> mib = option_value<std::uint64_t>(arg);
+      if (!mib || *mib < 1) {
+        print_usage(argv[0]);
+        return 1;
+      }
+      compare_size = *mib * 1024 * 1024;
+      continue;
+    }
+    if (arg.starts_with("--host-allocator=")) {
+      const std::string_view kind = arg.substr(arg.find('=') + 1);
+      if (kind == "counting") {
+        host_allocator_kind = HostAllocatorKind::counting;
+      } else if (kind == "arena") {
+        host_allocator_kind = HostAllocatorKind::arena;
+      } else {
+        print_usage(argv[0]);
+        return 1;
+      }
+      continue;
+    }
+    const Benchmark *benchmark = find_benchmark(arg);
+    if (!benchmark) {
+      print_usage(argv[0]);
+      return 1;
+    }
+    selected.push_back(benchmark);
+  }
+  if (compare[0] && (!selected.empty() || budget_seconds || round_count)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  if (selected.empty()) {
+    selected.push_back(find_benchmark("copy"));
+  }
+  if (budget_seconds && round_count) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  // Outlives the context, which hands its callbacks to the driver
+  std::unique_ptr<HostAllocator> host_allocator;
+  if (host_allocator_kind) {
+    host_allocator.reset(new HostAllocator(*host_allocator_kind));
+  }
+  Context context(validation, Robustness::none, host_allocator ? host_allocator->callbacks() : nullptr);
+  std::ostringstream environment_report;
+  print_environment(capture_environment(context), environment_report);
+  std::cout << environment_report.str();
+
+  if (compare[0]) {
+    compare_copy_variants(context, *compare[0], *compare[1], compare_size, seed);
+    return 0;
+  }
+
+  const std::filesystem::path cache_directory = ResultsCache::default_directory();
+  std::optional<ResultsCache> cache;
+  if (use_cache && !cache_directory.empty()) {
+    cache.emplace(cache_directory, max_age);
+  }
+  // The allocator is part of what was measured
+  std::string environment = environment_key(context);
+  if (host_allocator_kind) {
+    environment += std::string("host_allocator=") +
+                   (*host_allocator_kind == HostAllocatorKind::arena ? "arena" : "counting") + '\n';
+  }
+
+  if (!budget_seconds && !round_count) {
+    for (const Benchmark *benchmark : selected) {
+      run_benchmark(context, host_allocator.get(), cache, environment, environment_report.str(), *benchmark);
+    }
+    return 0;
+  }
+
+  // With --rounds, benchmarks without suite points run once in full first,
+  // not once per round, in an order shuffled by the seed like that of the
+  // points. They bypass the cache so that they are measured in this run. A
+  // budget is a hard cap on the suite, which they cannot keep to, so they are
+  // skipped under one.
+  std::mt19937_64 random(seed);
+  std::shuffle(selected.begin(), selected.end(), random);
+  const Clock::time_point start = Clock::now();
+  std::vector<SuitePoint> points;
+  for (const Benchmark *benchmark : selected) {
+    if (benchmark->points) {
+      std::vector<SuitePoint> benchmark_points = benchmark->points(context);
+      std::move(benchmark_points.begin(), benchmark_points.end(), std::back_inserter(points));
+    } else if (budget_seconds) {
+      std::cout << "[" << benchmark->name << ": skipped, it has no suite points to fit in the budget]\n";
+    } else {
+      std::cout << "[" << benchmark->name << ": runs once in full, not per round, seed " << seed << "]\n";
+      run_benchmark(context, host_allocator.get(), std::nullopt, environment, environment_report.str(), *benchmark);
+    }
+  }
+  if (points.empty()) {
+    return 0;
+  }
+
+  if (MemoryReport *memory_report = context.memory_report()) {
+    memory_report->reset();
+  }
+  if (host_allocator) {
+    host_allocator->reset();
+  }
+  context.reset_footprint();
+  reset_peak_rss();
+  std::optional<VkDeviceSize> heap_usage_before = context.device_local_heap_usage();
+  std::ostringstream description;
+  std::vector<SuiteResult> results;
+  if (budget_seconds) {
+    results = run_suite(points, std::max(0.0, *budget_seconds - elapsed_seconds(start)), seed);
+    description << *budget_seconds << " s budget, " << elapsed_seconds(start) << " s used";
+  } else {
+    results = run_rounds(points, *round_count, round_sample_count, seed);
+    description << *round_count << " rounds of " << round_sample_count << " samples";
+  }
+  // The seed reproduces the order of the points with --seed
+  std::cout << "suite (" << description.str() << ", seed " << seed << ")\n--------------------\n";
+  print_suite_results(points, results);
+  print_footprint(context, heap_usage_before);
+  if (const MemoryReport *memory_report = context.memory_report()) {
+    print_memory_report(memory_report->totals());
+  }
+  if (host_allocator) {
+    print_host_allocations(host_allocator->totals());
   }
 }
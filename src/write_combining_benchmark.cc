@@ -0,0 +1,234 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "benchmark.hh"
+#include "hostcopy.hh"
+#include "vkcontext.hh"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+namespace {
+
+constexpr VkDeviceSize buffer_size = 16 * 1024 * 1024;
+constexpr std::size_t line_size = 64;
+// The fastest of this many passes counts, after one that faults the pages in
+constexpr int pass_count = 3;
+
+struct MemoryKind {
+  const char *name;
+  std::uint32_t flags;
+};
+
+// Uncached host-visible memory is usually write-combined. Cached memory is
+// the reference.
+constexpr std::array memory_kinds{
+    MemoryKind{"coherent", VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT},
+    MemoryKind{"device-local coherent", VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT},
+    MemoryKind{"coherent cached", VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                                      VK_MEMORY_PROPERTY_HOST_CACHED_BIT},
+};
+
+// The mapped buffer and the orders that the random patterns visit it in
+struct Target {
+  std::span<std::uint8_t> data;
+  std::vector<std::uint32_t> line_order;
+  std::vector<std::uint32_t> word_order;
+};
+
+// Bytes that stores copy from
+alignas(line_size) constexpr std::array<std::uint8_t, line_size> pattern = [] {
+  std::array<std::uint8_t, line_size> pattern{};
+  for (std::size_t i = 0; i < line_size; i++) {
+    pattern[i] = static_cast<std::uint8_t>(i * 37 + 11);
+  }
+  return pattern;
+}();
+
+// Keeps interleaved reads from being optimized out
+volatile std::uint64_t read_sink;
+
+// The widest word that a store of Size bytes is made of
+template <std::size_t Size> auto widest_word() {
+  if constexpr (Size == 1) {
+    return std::uint8_t{};
+  } else if constexpr (Size == 4) {
+    return std::uint32_t{};
+#if defined(__AVX__)
+  } else if constexpr (Size >= 32) {
+    return Vector256{};
+#endif
+#if defined(__SSE2__)
+  } else if constexpr (Size >= 16) {
+    return Vector128{};
+#endif
+  } else {
+    return std::uint64_t{};
+  }
+}
+
+// Size bytes at dst, as few stores as the target allows
+template <std::size_t Size, bool NonTemporal> inline void store_bytes(std::uint8_t *dst, const std::uint8_t *src) {
+  using Word = decltype(widest_word<Size>());
+  for (std::size_t i = 0; i < Size / sizeof(Word); i++) {
+    store_word<Word, NonTemporal>(dst + i * sizeof(Word), load_word<Word>(src + i * sizeof(Word)));
+  }
+}
+
+// Each function writes the buffer once and returns the bytes it wrote
+
+template <std::size_t Size, bool NonTemporal> std::uint64_t sequential(const Target &target) {
+  for (std::size_t offset = 0; offset < target.data.size(); offset += Size) {
+    store_bytes<Size, NonTemporal>(target.data.data() + offset, pattern.data() + offset % line_size);
+  }
+  stream_fence();
+  return target.data.size();
+}
+
+// The first Bytes of every line, in 8 B stores
+template <std::size_t Bytes, bool NonTemporal> std::uint64_t partial_lines(const Target &target) {
+  for (std::size_t line = 0; line < target.data.size(); line += line_size) {
+    for (std::size_t offset = 0; offset < Bytes; offset += sizeof(std::uint64_t)) {
+      store_bytes<sizeof(std::uint64_t), NonTemporal>(target.data.data() + line + offset, pattern.data() + offset);
+    }
+  }
+  stream_fence();
+  return target.data.size() / line_size * Bytes;
+}
+
+// Whole lines, in a random line order
+template <bool NonTemporal> std::uint64_t random_lines(const Target &target) {
+  for (std::uint32_t line : target.line_order) {
+    store_bytes<line_size, NonTemporal>(target.data.data() + line * line_size, pattern.data());
+  }
+  stream_fence();
+  return target.data.size();
+}
+
+// 8 B stores in a random order over the whole buffer
+template <bool NonTemporal> std::uint64_t random_words(const Target &target) {
+  for (std::uint32_t word : target.word_order) {
+    store_bytes<sizeof(std::uint64_t), NonTemporal>(target.data.data() + word * sizeof(std::uint64_t),
+                                                    pattern.data() + word * sizeof(std::uint64_t) % line_size);
+  }
+  stream_fence();
+  return target.data.size();
+}
+
+// Whole lines in order, reading back the line just written every
+// ReadInterval lines, as serialization code that patches earlier fields does
+template <std::size_t ReadInterval, bool NonTemporal> std::uint64_t interleaved_reads(const Target &target) {
+  std::uint64_t sum = 0;
+  std::size_t line_count = 0;
+  for (std::size_t line = 0; line < target.data.size(); line += line_size) {
+    store_bytes<line_size, NonTemporal>(target.data.data() + line, pattern.data());
+    if (++line_count % ReadInterval == 0) {
+      sum += *reinterpret_cast<const volatile std::uint64_t *>(target.data.data() + line);
+    }
+  }
+  stream_fence();
+  read_sink = sum;
+  return target.data.size();
+}
+
+struct WriteCase {
+  const char *name;
+  std::uint64_t (*regular)(const Target &);
+  // nullptr if there is no non-temporal store of this size
+  std::uint64_t (*non_temporal)(const Target &);
+};
+
+constexpr std::array write_cases{
+    WriteCase{"sequential 1 B", sequential<1, false>, nullptr},
+    WriteCase{"sequential 4 B", sequential<4, false>, sequential<4, true>},
+    WriteCase{"sequential 8 B", sequential<8, false>, sequential<8, true>},
+    WriteCase{"sequential 16 B", sequential<16, false>, sequential<16, true>},
+    WriteCase{"sequential 32 B", sequential<32, false>, sequential<32, true>},
+    WriteCase{"sequential 64 B", sequential<64, false>, sequential<64, true>},
+    WriteCase{"partial lines 8/64 B", partial_lines<8, false>, partial_lines<8, true>},
+    WriteCase{"partial lines 32/64 B", partial_lines<32, false>, partial_lines<32, true>},
+    WriteCase{"partial lines 48/64 B", partial_lines<48, false>, partial_lines<48, true>},
+    WriteCase{"partial lines 56/64 B", partial_lines<56, false>, partial_lines<56, true>},
+    WriteCase{"random lines 64 B", random_lines<false>, random_lines<true>},
+    WriteCase{"random 8 B", random_words<false>, random_words<true>},
+    WriteCase{"read every line", interleaved_reads<1, false>, interleaved_reads<1, true>},
+    WriteCase{"read every 16 lines", interleaved_reads<16, false>, interleaved_reads<16, true>},
+};
+
+// Full lines in order, which the other cases are compared to
+constexpr std::size_t full_line_case = 5;
+static_assert(std::string_view(write_cases[full_line_case].name) == "sequential 64 B");
+
+// Bandwidth of bytes written, over the fastest pass
+double write_mib_per_second(const Target &target, std::uint64_t (*write)(const Target &)) {
+  write(target);
+  std::uint64_t bytes = 0;
+  double seconds = std::numeric_limits<double>::infinity();
+  for (int pass = 0; pass < pass_count; pass++) {
+    const Clock::time_point start = Clock::now();
+    bytes = write(target);
+    seconds = std::min(seconds, elapsed_seconds(start));
+  }
+  return mib_per_second(bytes, seconds);
+}
+
+void memory_kind_benchmark(Context &context, const MemoryKind &kind, Target &target) {
+  Buffer buffer = context.create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+  buffer.allocate(kind.flags);
+  target.data = buffer.mmap();
+
+  std::vector<std::array<std::optional<double>, 2>> results;
+  for (const WriteCase &write_case : write_cases) {
+    results.push_back({write_mib_per_second(target, write_case.regular), std::nullopt});
+    if (non_temporal_stores_supported && write_case.non_temporal) {
+      results.back()[1] = write_mib_per_second(target, write_case.non_temporal);
+    }
+  }
+
+  // Whichever store kind is faster
+  const std::array<std::optional<double>, 2> &full_lines = results[full_line_case];
+  const double baseline = std::max(*full_lines[0], full_lines[1].value_or(0));
+  std::cout << kind.name << '\n';
+  for (std::size_t i = 0; i < write_cases.size(); i++) {
+    std::cout << "  " << write_cases[i].name << ": " << *results[i][0] << " MiB/sec ("
+              << *results[i][0] / baseline * 100 << "%)";
+    if (results[i][1]) {
+      std::cout << ", non-temporal " << *results[i][1] << " MiB/sec (" << *results[i][1] / baseline * 100 << "%)";
+    }
+    std::cout << '\n';
+  }
+}
+
+} // namespace
+
+void write_combining_benchmark(Context &context) {
+  Target target;
+  target.line_order.resize(buffer_size / line_size);
+  std::iota(target.line_order.begin(), target.line_order.end(), 0);
+  target.word_order.resize(buffer_size / sizeof(std::uint64_t));
+  std::iota(target.word_order.begin(), target.word_order.end(), 0);
+  // Fixed, so that every run visits the buffer in the same order
+  std::mt19937 random(0);
+  std::shuffle(target.line_order.begin(), target.line_order.end(), random);
+  std::shuffle(target.word_order.begin(), target.word_order.end(), random);
+
+  std::cout << "write combining (" << buffer_size / 1024 / 1024 << " MiB, bandwidth of bytes written, % of "
+            << write_cases[full_line_case].name << ")\n--------------------\n";
+  for (const MemoryKind &kind : memory_kinds) {
+    if (!context.has_memory_type(kind.flags)) {
+      std::cout << kind.name << ": skipped, no such memory type\n";
+      continue;
+    }
+    memory_kind_benchmark(context, kind, target);
+  }
+}